@@ -19,8 +19,9 @@
 
 
 #include "A429.h"
+#include <algorithm>
 #include <cstdio>
-#include <sstream>
+#include <ctime>
 #include <unistd.h>
 
 
@@ -33,7 +34,10 @@
 #define ipOctets_to_ADT_L0_UINT32(class1, class2, subnet, hostNum) (ADT_L0_UINT32)((class1 << 24) | (class2 << 16) | (subnet << 8) | hostNum)
 
 
-A429::A429() : _isOpen(false), _isSetup(false), _irigFail(0), _failCounter(0), _port(56769), _statusPort(0)
+A429::A429() : _isOpen(false), _isSetup(false), _irigFail(0), _failCounter(0), _port(56769), _statusPort(0),
+	_irigDac(-1), _irigDacFile("/var/tmp/arinc_ctrl.irigdac"),
+	_opens(0), _attaches(0), _pbitFailures(0), _calibrations(0), _calibrationFailures(0),
+	_adcpTransactions(0), _adcpRetries(0), _adcpFailures(0), _irigDetected(0), _irigLocked(0)
 {
   setEnetIP("192.168.84.12");
   setACserverIP("192.168.84.2");
@@ -51,6 +55,8 @@ void A429::Open()
 printf("Open()\n");
   ADT_L0_UINT32	status = ADT_SUCCESS, rootCsr, timeLow, timeHigh;
 
+  bump(_opens);
+
 
   /* Set up the eNet device for APMP operation. */
   Setup();
@@ -176,6 +182,11 @@ void A429::Setup()
 */
 
 
+  // The PE reset above stopped and cleared every RX channel.
+  _channelList.clear();
+  _channelSetup.clear();
+  _channelTable.clear();
+
   /* Setup the Multichannel (MC) RX buffer, 100 RXPs.  As long as there is at least one
    * RXP allocated for the MC buffer, APMP can function.  As labels are written
    * to the MC buffer, they are immediately copied to the APMP buffer if APMP is enabled. */
@@ -188,20 +199,211 @@ void A429::Setup()
 }
 
 
+/* After a network dropout the device has normally carried on receiving and
+ * sending APMP as we left it; only the ADCP link went away.  The library's
+ * memory map is still this process's, so if the device checks out there is
+ * nothing to redo and data resumes with the link.  A power cycle or PE
+ * reset turns APMP off and clears the RX setup, which is what we look for.
+ */
+static const int RX_REG_WORDS = ADT_L1_A429_RXREG_CHAN_SIZE / 4;
+static const int RX_CHANNELS = 16;
+
+bool A429::Attach()
+{
+printf("Attach()\n");
+  A429status s;
+  ADT_L0_UINT32 mcrxp = 0, rx[RX_CHANNELS * RX_REG_WORDS];
+
+  if (!_isSetup)
+    return false;
+
+  if (!ReadStatus(s) || s.bitResult != ADT_SUCCESS) {
+    printf("Attach: device not answering or failing BIT, %u\n", s.bitResult);
+    return false;
+  }
+
+  if ((s.rootCSR & ADT_L1_A429_PECSR_ENET_APMP_ENABLE) == 0) {
+    printf("Attach: APMP is off, CSR=0x%x\n", s.rootCSR);
+    return false;
+  }
+
+  if (ADT_L1_ReadDeviceMem32(DEVID, ADT_L1_A429_PE_MCRXP_DATATBLPTR, &mcrxp, 1) != ADT_SUCCESS || mcrxp == 0) {
+    printf("Attach: no multichannel RX buffer\n");
+    return false;
+  }
+
+  if (ReadBlock(DEVID, ADT_L1_A429_ROOT_RX_REGS, rx, RX_CHANNELS * RX_REG_WORDS) != ADT_SUCCESS) {
+    printf("Attach: can't read the RX channel registers\n");
+    return false;
+  }
+
+  for (size_t i = 0; i < _channelList.size(); ++i)
+  {
+    const ADT_L0_UINT32 *reg = &rx[_channelList[i] * RX_REG_WORDS];
+    ADT_L0_UINT32 setup = reg[ADT_L1_A429_RXREG_SETUP1 / 4], table = reg[ADT_L1_A429_RXREG_DATATBLPTR / 4];
+
+    if (setup != _channelSetup[i] || table != _channelTable[i]) {
+      printf("Attach: channel %d setup 0x%x table 0x%x, started as 0x%x 0x%x\n",
+	_channelList[i], setup, table, _channelSetup[i], _channelTable[i]);
+      return false;
+    }
+  }
+
+  _failCounter = 0;
+  bump(_attaches);
+  printf("Attached, CSR=0x%x, %zu channels running\n", s.rootCSR, _channelList.size());
+  return true;
+}
+
+
+/* IRIG DAC calibration.  ADT_L1_Global_CalibrateIrigDac() steps the DAC up
+ * from 0 by 25 with a 1 second sleep per step, up to 40 seconds.  Here we
+ * start from the last value that locked, which nearly always still does,
+ * and poll the lock bit instead of sleeping a fixed second.  Failing that,
+ * try the same 25 step grid coarse to fine until something locks, then
+ * bisect to both edges of the lock window and settle in the middle, so
+ * the saved value has margin next time.
+ */
+static const int DAC_MAX = 1023;
+static const int DAC_TYPICAL = 100;	// ADT's first guess
+static const int DAC_STEP = 25;
+static const int DAC_RESOLUTION = 12;	// edges to within this; margin, not precision
+static const int LOCK_SETTLE_MS = 100;	// before the first look at the lock bit
+static const int LOCK_POLL_MS = 50;
+static const int LOCK_TIMEOUT_MS = 1000;	// what ADT sleeps per step
+static const int LOCK_CONFIRM = 2;	// consecutive polls; a stale lock bit can't pass
+
+
+bool A429::TryIrigDac(int value)
+{
+  ADT_L0_UINT32 csr;
+  int seen = 0;
+
+  if (ADT_L1_Global_I2C_SetIrigDac(DEVID_GLOBAL, value) != ADT_SUCCESS)
+    return false;
+
+  usleep(LOCK_SETTLE_MS * 1000);
+  for (int ms = LOCK_SETTLE_MS; ms <= LOCK_TIMEOUT_MS; ms += LOCK_POLL_MS)
+  {
+    csr = 0;
+    if (ADT_L1_ReadDeviceMem32(DEVID_GLOBAL, ADT_L1_GLOBAL_CSR, &csr, 1) == ADT_SUCCESS &&
+	(csr & ADT_L1_GLOBAL_CSR_IRIG_LOCK))
+    {
+      if (++seen >= LOCK_CONFIRM)
+        return true;
+    }
+    else
+      seen = 0;
+    usleep(LOCK_POLL_MS * 1000);
+  }
+  return false;
+}
+
+
+int A429::IrigDacEdge(int locked, int dir)
+{
+  int step = DAC_STEP, unlocked;
+
+  // Gallop until something does not lock, or we run off the end.
+  while (true)
+  {
+    unlocked = locked + dir * step;
+    if (unlocked < 0 || unlocked > DAC_MAX) {
+      unlocked = dir > 0 ? DAC_MAX + 1 : -1;
+      break;
+    }
+    if (!TryIrigDac(unlocked))
+      break;
+    locked = unlocked;
+    step *= 2;
+  }
+
+  // Edge is between locked and unlocked.
+  while (abs(unlocked - locked) > DAC_RESOLUTION)
+  {
+    int mid = (locked + unlocked) / 2;
+    if (TryIrigDac(mid))
+      locked = mid;
+    else
+      unlocked = mid;
+  }
+  return locked;
+}
+
+
 void A429::CalibrateIRIG()
 {
 printf("CalibrateIRIG\n");
-  ADT_L0_UINT32 status;
+  struct timespec start, end;
+  int found = -1;
   _irigFail = true;
 
-  status = ADT_L1_Global_CalibrateIrigDac(DEVID_GLOBAL);
-  if (status != ADT_SUCCESS)
+  bump(_calibrations);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (_irigDac < 0)
   {
-    printf("ADT_L1_Global_CalibrateIrigDac failed, status = %d\n", status);
-    printf("IRIG signal failed to calibrate.\n");
+    FILE *fp = fopen(_irigDacFile.c_str(), "r");
+    if (fp) {
+      if (fscanf(fp, "%d", &_irigDac) != 1 || _irigDac < 0 || _irigDac > DAC_MAX)
+        _irigDac = -1;
+      fclose(fp);
+    }
   }
+  int first = _irigDac >= 0 ? _irigDac : DAC_TYPICAL;
+
+  if (TryIrigDac(first))
+    found = first;
   else
-    _irigFail = false;	// success.
+  {
+    // Every multiple of DAC_STEP, as ADT does, but coarse to fine (bit
+    // reversed order: 800, 400, 1200 skipped, 200, 600, 1000, ...) so a
+    // window of width w turns up after about 1024 / w tries wherever it is.
+    for (int r = 0; found < 0 && r < 64; ++r)
+    {
+      int k = 0;
+      for (int bit = 0; bit < 6; ++bit)
+        k |= ((r >> bit) & 1) << (5 - bit);
+      int value = k * DAC_STEP;
+      if (value <= DAC_MAX && value != first && TryIrigDac(value))
+        found = value;
+    }
+
+    if (found >= 0)
+    {
+      int low = IrigDacEdge(found, -1), high = IrigDacEdge(found, +1);
+      printf("IRIG DAC lock window %d - %d\n", low, high);
+      found = (low + high) / 2;
+      if (!TryIrigDac(found))
+        found = -1;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+
+  if (found < 0)
+  {
+    bump(_calibrationFailures);
+    printf("IRIG DAC calibration failed after %.1f s, no lock 0 - %d\n", seconds, DAC_MAX);
+    printf("IRIG signal failed to calibrate.\n");
+    return;
+  }
+
+  printf("IRIG DAC %d locked in %.1f s\n", found, seconds);
+  _irigFail = false;	// success.
+
+  if (found != _irigDac)
+  {
+    _irigDac = found;
+    FILE *fp = fopen(_irigDacFile.c_str(), "w");
+    if (fp) {
+      fprintf(fp, "%d\n", _irigDac);
+      fclose(fp);
+    }
+    else
+      fprintf(stderr, "A429: can't save IRIG DAC value to %s\n", _irigDacFile.c_str());
+  }
 }
 
 
@@ -233,112 +435,385 @@ printf("StartChannel %d %d\n", channel, speed);
   /* Now Start the Receive Channels. */
   status = ADT_L1_A429_RX_Channel_Start(DEVID, channel);
   if (status != ADT_SUCCESS)
+  {
     printf("ADT_L1_A429_RX_Channel_Start(%d) failed, status=%d\n", channel, status);
+    return;
+  }
+
+  // SETUP1 through the data table pointer, as Attach() should find them.
+  ADT_L0_UINT32 reg[ADT_L1_A429_RXREG_DATATBLPTR / 4 + 1] = { 0 };
+  ADT_L1_ReadDeviceMem32(DEVID, ADT_L1_A429_ROOT_RX_REGS + channel * ADT_L1_A429_RXREG_CHAN_SIZE, reg, ADT_L1_A429_RXREG_DATATBLPTR / 4 + 1);
+
+  _channelList.push_back(channel);
+  _channelSetup.push_back(reg[ADT_L1_A429_RXREG_SETUP1 / 4]);
+  _channelTable.push_back(reg[ADT_L1_A429_RXREG_DATATBLPTR / 4]);
+}
+
+
+/* ADT_L1_A429_RX_Channel_Init() writes the setup registers and every word
+ * of the RxP table one ADCP round trip at a time, some 420 per channel at
+ * 100 RxPs.  StartChannels() leaves the device just as RX_Channel_Init and
+ * RX_Channel_Start would, so RX_Channel_Close still undoes it, in about 70
+ * round trips for all eight channels.
+ */
+static const int RXP_COUNT = 100;	// per channel, as StartChannel()
+static const int RXP_TABLE_WORDS = (ADT_L1_A429_RXP_HDR_SIZE + ADT_L1_A429_RXP_SIZE * RXP_COUNT) / 4;
+
+void A429::StartChannels(const std::vector<ChannelInfo> &channels)
+{
+printf("StartChannels %zu\n", channels.size());
+  ADT_L0_UINT32 status, chanConfig = 0, base;
+  ADT_L0_UINT32 rx[RX_CHANNELS * RX_REG_WORDS];
+  unsigned int speed[RX_CHANNELS] = { 0 };
+  std::vector<int> start;
+
+  status = ADT_L1_A429_GetConfig(DEVID, &chanConfig);
+  if (status != ADT_SUCCESS)
+  {
+    printf("ADT_L1_A429_GetConfig failed, status=%d\n", status);
+    return;
+  }
+
+  for (size_t i = 0; i < channels.size(); ++i)
+  {
+    int channel = channels[i].Channel();
+    if ((chanConfig & (1 << channel)) == 0)
+      printf("StartChannels: device has no RX channel %d\n", channel);
+    else if (speed[channel] == 0 &&
+	std::find(_channelList.begin(), _channelList.end(), channel) == _channelList.end())
+    {
+      speed[channel] = channels[i].Speed();
+      start.push_back(channel);
+    }
+  }
+  if (start.empty())
+    return;
+  std::sort(start.begin(), start.end());
+
+  // RxP tables, channel after channel in one allocation.  MemoryAlloc
+  // clears it in blocks; then the header RxP count and each RxP's control
+  // word and empty time stamp.
+  std::vector<ADT_L0_UINT32> table(start.size() * RXP_TABLE_WORDS, 0);
+  status = ADT_L1_MemoryAlloc(DEVID, table.size() * 4, &base);
+  if (status != ADT_SUCCESS)
+  {
+    printf("ADT_L1_MemoryAlloc(%zu) failed, status=%d\n", table.size() * 4, status);
+    return;
+  }
+
+  for (size_t i = 0; i < start.size(); ++i)
+  {
+    ADT_L0_UINT32 *t = &table[i * RXP_TABLE_WORDS];
+    t[ADT_L1_A429_RXP_HDR_TOTAL_RXPCNT / 4] = RXP_COUNT;
+    for (int j = 0; j < RXP_COUNT; ++j)
+    {
+      ADT_L0_UINT32 *rxp = t + (ADT_L1_A429_RXP_HDR_SIZE + ADT_L1_A429_RXP_SIZE * j) / 4;
+      rxp[ADT_L1_A429_RXP_CONTROL / 4] = (start[i] << 24) | j;
+      rxp[ADT_L1_A429_RXP_TIMEHIGH / 4] = 0xffffffff;
+      rxp[ADT_L1_A429_RXP_TIMELOW / 4] = 0xffffffff;
+    }
+  }
+
+  status = WriteBlock(DEVID, base, &table[0], table.size());
+  if (status != ADT_SUCCESS)
+  {
+    printf("StartChannels: RxP table write failed, status=%d\n", status);
+    return;
+  }
+
+  // Setup registers, RX still off.  Read them all first, for the channels
+  // in between that the start writes below go over.
+  status = ReadBlock(DEVID, ADT_L1_A429_ROOT_RX_REGS, rx, RX_CHANNELS * RX_REG_WORDS);
+  if (status != ADT_SUCCESS)
+  {
+    printf("StartChannels: RX register read failed, status=%d\n", status);
+    return;
+  }
+
+  for (size_t i = 0; i < start.size(); ++i)
+  {
+    ADT_L0_UINT32 *reg = &rx[start[i] * RX_REG_WORDS];
+    ADT_L0_UINT32 halfBitTimeUs = (ADT_L0_UINT32)((1.0 / (speed[start[i]] * 2.0)) * 1000000) & 0x000003FF;
+
+    // 32 bits per word, A429 high/low/parity, into the MC buffer.
+    reg[ADT_L1_A429_RXREG_SETUP1 / 4] = 0x80008430 | (halfBitTimeUs << 16) | ADT_L1_A429_RXREG_SETUP1_MCRX;
+    reg[ADT_L1_A429_RXREG_SETUP2 / 4] = 0;
+    reg[ADT_L1_A429_RXREG_RXPCNT / 4] = 0;
+    reg[ADT_L1_A429_RXREG_DATATBLPTR / 4] = base + i * RXP_TABLE_WORDS * 4;
+    reg[ADT_L1_A429_RXREG_MASK1 / 4] = 0;
+    reg[ADT_L1_A429_RXREG_COMPARE1 / 4] = 0xffffffff;
+    reg[ADT_L1_A429_RXREG_MASK2 / 4] = 0;
+    reg[ADT_L1_A429_RXREG_COMPARE2 / 4] = 0xffffffff;
+    reg[ADT_L1_A429_RXREG_LABELCVTPTR / 4] = 0;
+  }
+
+  // Adjacent channels go in one write.
+  for (size_t i = 0, n; i < start.size(); i += n)
+  {
+    for (n = 1; i + n < start.size() && start[i + n] == start[i] + (int)n; ++n)
+      ;
+    status = WriteBlock(DEVID, ADT_L1_A429_ROOT_RX_REGS + start[i] * ADT_L1_A429_RXREG_CHAN_SIZE,
+	&rx[start[i] * RX_REG_WORDS], n * RX_REG_WORDS);
+    if (status != ADT_SUCCESS)
+    {
+      printf("StartChannels: RX setup write from channel %d failed, status=%d\n", start[i], status);
+      return;
+    }
+  }
+
+  // Turn them on.  The PE has no RX enable of its own, only RXON in each
+  // channel's SETUP1, 16 words apart; so write from the first SETUP1 to
+  // the last, up to seven channels in one ADT_RW_MEM_MAX_SIZE write.  What
+  // lies between is rewritten as it stands, so stop short of a channel
+  // that is already running.
+  for (size_t i = 0; i < start.size(); )
+  {
+    int low = start[i], high = low;
+    size_t n = 1;
+    for (int channel = low + 1; channel < RX_CHANNELS && (channel - low) * RX_REG_WORDS < ADT_RW_MEM_MAX_SIZE; ++channel)
+    {
+      if (i + n < start.size() && start[i + n] == channel) {
+        high = channel;
+        ++n;
+      }
+      else if (rx[channel * RX_REG_WORDS] & ADT_L1_A429_RXREG_SETUP1_RXON)
+        break;
+    }
+
+    for (size_t k = i; k < i + n; ++k)
+      rx[start[k] * RX_REG_WORDS] |= ADT_L1_A429_RXREG_SETUP1_RXON;
+
+    status = ADT_L1_WriteDeviceMem32(DEVID, ADT_L1_A429_ROOT_RX_REGS + low * ADT_L1_A429_RXREG_CHAN_SIZE,
+	&rx[low * RX_REG_WORDS], (high - low) * RX_REG_WORDS + 1);
+
+    for (size_t k = i; k < i + n; ++k)
+    {
+      const ADT_L0_UINT32 *reg = &rx[start[k] * RX_REG_WORDS];
+      if (status != ADT_SUCCESS)
+        printf("StartChannels: RX start of channel %d failed, status=%d\n", start[k], status);
+      else
+      {
+        _channelList.push_back(start[k]);
+        _channelSetup.push_back(reg[ADT_L1_A429_RXREG_SETUP1 / 4]);
+        _channelTable.push_back(reg[ADT_L1_A429_RXREG_DATATBLPTR / 4]);
+      }
+    }
+    i += n;
+  }
+}
+
+
+/* The PE registers in the STATUS line, ROOT_CSR (0x0000) through BITSTATUS
+ * (0x002C), read as one block.
+ *
+ * PE Control Register (ADT_L1_A429_PE_ROOT_CSR, 0x0000): General ARINC configs (APMP, reset, trig, extclk, interrupts)
+ * PE Status Register (ADT_L1_A429_PE_ROOT_STS, 0x0004): ARINC status (IRIG det, IRIG lock, interrupt pending)
+ *
+ * PE BIT Status (ADT_L1_A429_PE_BITSTATUS, 0x002C): BIT tests
+ */
+static const int STATUS_WORDS = ADT_L1_A429_PE_BITSTATUS / 4 + 1;
+
+bool A429::ReadStatus(A429status &s)
+{
+  ADT_L0_UINT32 pe[STATUS_WORDS], status;
+
+  status = ReadBlock(DEVID, ADT_L1_A429_PE_ROOT_CSR, pe, STATUS_WORDS);
+  s.rootCSR = pe[ADT_L1_A429_PE_ROOT_CSR / 4];
+  s.rootSTS = pe[ADT_L1_A429_PE_ROOT_STS / 4];
+  s.peBIT = pe[ADT_L1_A429_PE_BITSTATUS / 4];
+
+  // What ADT_L1_BIT_PeriodicBIT() does, less its 10ms sleep and a read.
+  if (status != ADT_SUCCESS) {
+    s.bitResult = status;
+    s.bitStatus = 0;
+  }
+  else {
+    s.bitResult = (s.peBIT & ADT_L1_A429_BIT_PBITFAIL) ? ADT_FAILURE : ADT_SUCCESS;
+    s.bitStatus = s.peBIT;
+  }
+
+  s.globalCSR = 0xffffffff;
+  s.globalResult = ADT_L1_ReadDeviceMem32(DEVID_GLOBAL, ADT_L1_GLOBAL_CSR, &s.globalCSR, 1);
+
+  // These stats will be for the TCP conenction between this program and the device.
+  s.transactions = s.retries = s.failures = 0xffffffff;
+  s.adcpPort = 0;
+  s.adcpResult = ADT_L1_ENET_ADCP_GetStatistics(DEVID, &s.adcpPort, &s.transactions, &s.retries, &s.failures);
+
+  return status == ADT_SUCCESS && s.globalResult == ADT_SUCCESS;
+}
+
+
+int A429::FormatStatus(const A429status &s, char *buf, size_t size)
+{
+  if (s.globalResult == ADT_SUCCESS)
+    return snprintf(buf, size, "STATUS,%u,%x,%x,%u,%u,%u,%u,%u,%x,%x,%x",
+	s.bitResult, s.bitStatus, s.globalCSR,
+	s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT, s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_LOCK,
+	s.transactions, s.retries, s.failures, s.rootCSR, s.rootSTS, s.peBIT);
   else
-    _channelList.push_back(channel);
+    return snprintf(buf, size, "STATUS,%u,%x,%x,-1,-1,%u,%u,%u,%x,%x,%x",
+	s.bitResult, s.bitStatus, s.globalCSR,
+	s.transactions, s.retries, s.failures, s.rootCSR, s.rootSTS, s.peBIT);
 }
 
 
 std::string A429::Status()
 {
-  ADT_L0_UINT32 status, bitStatus = 0xffffffff, globalCSR = 0xffffffff;
-  ADT_L0_UINT32 portnum, transactions = 0xffffffff, retries = 0xffffffff, failures = 0xffffffff;
-  std::stringstream statusStr;
-  statusStr << "STATUS,";
-
-  bitStatus = 0;
-  status = ADT_L1_BIT_PeriodicBIT(DEVID, &bitStatus);
-  statusStr << status << "," << std::hex << bitStatus << ",";
-  if (status != ADT_SUCCESS) {
+  A429status s;
+  struct timespec start, end;
+  char line[160];
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ReadStatus(s);
+
+  if (s.bitResult != ADT_SUCCESS) {
     fprintf(stderr, "PBIT FAILED!\n");
-    DisplayBitFailure(bitStatus);
+    DisplayBitFailure(s.bitStatus);
     _failCounter++;
+    bump(_pbitFailures);
   }
   else
   {
     _failCounter = 0;
-    if (bitStatus) printf("\nBIT Status = %08X\n", bitStatus);
+    if (s.bitStatus) printf("\nBIT Status = %08X\n", s.bitStatus);
   }
 
-
   // Check IRIG status.
-  status = ADT_L1_ReadDeviceMem32(DEVID_GLOBAL, ADT_L1_GLOBAL_CSR, &globalCSR, 1);
-  statusStr << std::hex << globalCSR << "," << std::dec;
-  if (status == ADT_SUCCESS) {
-    statusStr	<< (globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT) << ","
-		<< (globalCSR & ADT_L1_GLOBAL_CSR_IRIG_LOCK);
-    _irigDetect = (globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT);
+  if (s.globalResult == ADT_SUCCESS) {
+    _irigDetect = (s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT);
+    _irigDetected.store(_irigDetect, std::memory_order_relaxed);
+    _irigLocked.store((s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_LOCK) != 0, std::memory_order_relaxed);
   }
-  else
-    statusStr << "-1,-1";
 
   printf("IRIG: Detect=%d, Lock=%d\n",
-	(globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT),
-	(globalCSR & ADT_L1_GLOBAL_CSR_IRIG_LOCK));
+	(s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_DETECT),
+	(s.globalCSR & ADT_L1_GLOBAL_CSR_IRIG_LOCK));
+
+  if (s.adcpResult == ADT_SUCCESS) {
+    printf("UDP Port %d:  %d transactions, %d retries, %d failures\n", s.adcpPort, s.transactions, s.retries, s.failures);
+    _adcpTransactions.store(s.transactions, std::memory_order_relaxed);
+    _adcpRetries.store(s.retries, std::memory_order_relaxed);
+    _adcpFailures.store(s.failures, std::memory_order_relaxed);
+  }
 
+  int len = FormatStatus(s, line, sizeof(line));
 
-  // These stats will be for the TCP conenction between this program and the device.
-  status = ADT_L1_ENET_ADCP_GetStatistics(DEVID, &portnum, &transactions, &retries, &failures);
-  if (status == ADT_SUCCESS) {
-    printf("UDP Port %d:  %d transactions, %d retries, %d failures\n", portnum, transactions, retries, failures);
-  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  _statusTime.add((end.tv_sec - start.tv_sec) * 1000000000LL + end.tv_nsec - start.tv_nsec);
 
-  statusStr << std::dec << "," << transactions << "," << retries << "," << failures << ",";
+  return std::string(line, len < (int)sizeof(line) ? len : sizeof(line) - 1);
+}
 
 
-  /*
-   * PE Control Register (ADT_L1_A429_PE_ROOT_CSR, 0x0000): General ARINC configs (APMP, reset, trig, extclk, interrupts)
-   * PE Status Register (ADT_L1_A429_PE_ROOT_STS, 0x0004): ARINC status (IRIG det, IRIG lock, interrupt pending)
-   *
-   * PE BIT Status (ADT_L1_A429_PE_BITSTATUS, 0x002C): BIT tests
-   */
-  bitStatus = 0xffffffff;
-  status = ADT_L1_ReadDeviceMem32(DEVID, ADT_L1_A429_PE_ROOT_CSR, &bitStatus, 1);
-  statusStr << std::hex << bitStatus << ",";
-  bitStatus = 0xffffffff;
-  status = ADT_L1_ReadDeviceMem32(DEVID, ADT_L1_A429_PE_ROOT_STS, &bitStatus, 1);
-  statusStr << std::hex << bitStatus << ",";
-  bitStatus = 0xffffffff;
-  status = ADT_L1_ReadDeviceMem32(DEVID, ADT_L1_A429_PE_BITSTATUS, &bitStatus, 1);
-  statusStr << std::hex << bitStatus;
-
-  return statusStr.str();
+void A429::addMetrics(APMPmetrics &m) const
+{
+  m.counter("alta_adcp_transactions_total", "ADCP transactions with the unit", 0, &_adcpTransactions, true);
+  m.counter("alta_adcp_retries_total", "ADCP retries", 0, &_adcpRetries);
+  m.counter("alta_adcp_failures_total", "ADCP failed transactions", 0, &_adcpFailures);
+  m.counter("alta_opens_total", "Device opens, first and after failures", 0, &_opens);
+  m.counter("alta_attaches_total", "Dropouts recovered by taking the running device back, no reset", 0, &_attaches);
+  m.counter("alta_pbit_failures_total", "Periodic BIT calls that failed", 0, &_pbitFailures);
+  m.counter("alta_irig_calibrations_total", "IRIG DAC calibrations", 0, &_calibrations);
+  m.counter("alta_irig_calibration_failures_total", "IRIG DAC calibrations that failed", 0, &_calibrationFailures);
+  m.gauge("alta_irig_detect", "Global CSR IRIG detect", 0, &_irigDetected);
+  m.gauge("alta_irig_lock", "Global CSR IRIG lock", 0, &_irigLocked);
+  m.histogram("alta_status_seconds", "Time to read the STATUS registers over ADCP", 0, &_statusTime);
 }
 
 
-std::string A429::RegisterDump()
+/* Register ranges in the dump, inclusive byte offsets.  One ADCP round trip
+ * per ADT_RW_MEM_MAX_SIZE words; five for all of these, was one per word.
+ */
+static const struct
+{
+  bool global;
+  ADT_L0_UINT32 first, last;
+} dumpRanges[] = {
+  { false, 0x0000, 0x00FC },
+  { true,  0x0040, 0x00FC },
+  { false, 0x0200, 0x05FC },
+};
+
+static void appendBigEndian(std::string &out, ADT_L0_UINT32 v)
 {
-  ADT_L0_UINT32 status, value;
-  std::stringstream output;
+  char b[4] = { (char)(v >> 24), (char)(v >> 16), (char)(v >> 8), (char)v };
+  out.append(b, 4);
+}
 
-  output << "REG_DUMP";
-  if (_failCounter > 0) {
-    output << ", failed to connect\n";
-    return output.str();
-  }
 
-  for (int i = 0; i <= 0x00FC; i += 4)
+ADT_L0_UINT32 A429::ReadBlock(ADT_L0_UINT32 devID, ADT_L0_UINT32 offset, ADT_L0_UINT32 *data, int count)
+{
+  ADT_L0_UINT32 status, result = ADT_SUCCESS;
+
+  for (int i = 0; i < count; i += ADT_RW_MEM_MAX_SIZE)
   {
-    value = 0xffffffff;
-    status = ADT_L1_ReadDeviceMem32(DEVID, i, &value, 1);
-    output << ", " << std::hex << i << "=" << value;
+    int n = count - i < ADT_RW_MEM_MAX_SIZE ? count - i : ADT_RW_MEM_MAX_SIZE;
+    status = ADT_L1_ReadDeviceMem32(devID, offset + i * 4, &data[i], n);
+    if (status != ADT_SUCCESS)
+    {
+      for (int j = 0; j < n; ++j)
+        data[i + j] = 0xffffffff;
+      if (result == ADT_SUCCESS)
+        result = status;
+    }
   }
+  return result;
+}
+
 
-  for (int i = 0x0040; i <= 0x00FC; i += 4)
+ADT_L0_UINT32 A429::WriteBlock(ADT_L0_UINT32 devID, ADT_L0_UINT32 offset, ADT_L0_UINT32 *data, int count)
+{
+  ADT_L0_UINT32 status, result = ADT_SUCCESS;
+
+  for (int i = 0; i < count; i += ADT_RW_MEM_MAX_SIZE)
   {
-    value = 0xffffffff;
-    status = ADT_L1_ReadDeviceMem32(DEVID_GLOBAL, i, &value, 1);
-    output << ", " << std::hex << i << "=" << value;
+    int n = count - i < ADT_RW_MEM_MAX_SIZE ? count - i : ADT_RW_MEM_MAX_SIZE;
+    status = ADT_L1_WriteDeviceMem32(devID, offset + i * 4, &data[i], n);
+    if (status != ADT_SUCCESS && result == ADT_SUCCESS)
+      result = status;
   }
+  return result;
+}
+
+
+std::string A429::RegisterDump(bool binary)
+{
+  ADT_L0_UINT32 values[256];
+  std::string output;
 
-  for (int i = 0x0200; i <= 0x05FC; i += 4)
+  if (_failCounter > 0)
+    return "REG_DUMP, failed to connect\n";
+
+  if (binary)
+    output.assign("REG_BIN", 8);	// keep the NUL
+  else
+    output = "REG_DUMP";
+
+  for (size_t r = 0; r < sizeof(dumpRanges) / sizeof(dumpRanges[0]); ++r)
   {
-    value = 0xffffffff;
-    status = ADT_L1_ReadDeviceMem32(DEVID, i, &value, 1);
-    output << ", " << std::hex << i << "=" << value;
+    ADT_L0_UINT32 first = dumpRanges[r].first;
+    int count = (dumpRanges[r].last - first) / 4 + 1;
+
+    ReadBlock(dumpRanges[r].global ? DEVID_GLOBAL : DEVID, first, values, count);
+
+    if (binary)
+    {
+      appendBigEndian(output, dumpRanges[r].global);
+      appendBigEndian(output, first);
+      appendBigEndian(output, count);
+      for (int i = 0; i < count; ++i)
+        appendBigEndian(output, values[i]);
+    }
+    else
+    {
+      char item[32];
+      for (int i = 0; i < count; ++i)
+        output.append(item, snprintf(item, sizeof(item), ", %x=%x", first + i * 4, values[i]));
+    }
   }
 
-  return output.str();
+  return output;
 }
 
 
@@ -1,9 +1,27 @@
 #include <ADT_L1.h>
 
+#include "apmp_metrics.h"
+#include "ChannelInfo.h"
+
 #include <cstdlib>
 #include <string>
 #include <vector>
 
+/**
+ * One reading of the registers behind the STATUS line, see A429::Status().
+ * Registers that could not be read are 0xffffffff.
+ */
+struct A429status
+{
+  ADT_L0_UINT32	bitResult;	// as ADT_L1_BIT_PeriodicBIT() would return it
+  ADT_L0_UINT32	bitStatus;	// PE BIT status as PBIT saw it, 0 if unread
+  ADT_L0_UINT32	globalResult;	// ReadDeviceMem32 status for globalCSR
+  ADT_L0_UINT32	globalCSR;
+  ADT_L0_UINT32	adcpResult, adcpPort;	// ADCP statistics, host side
+  ADT_L0_UINT32	transactions, retries, failures;
+  ADT_L0_UINT32	rootCSR, rootSTS, peBIT;
+};
+
 /**
  * Class to initialize and control Alta ENET ARINC appliance.
  */
@@ -19,10 +37,47 @@ public:
    */
   void Open();
   void Setup();
+
+  /**
+   * Take the device back as it is after a dropout, instead of Open()ing
+   * it again: no reset, memory test, buffer set up, IRIG calibration or
+   * channel starts.  Only if this process set it up, it passes PBIT, APMP
+   * is on and every channel we started is still receiving as we left it.
+   * @returns false if not; Open() it then.
+   */
+  bool Attach();
+
   void CalibrateIRIG();
   void StartChannel(int channel, int speed);
+
+  /**
+   * StartChannel() for all of channels at once: the RxP tables are laid
+   * out in one allocation and written in blocks, then the setup registers,
+   * then SETUP1 of up to seven neighbouring channels per write to turn
+   * them on.  Channels already started are left alone.
+   */
+  void StartChannels(const std::vector<ChannelInfo> &channels);
   std::string Status();
-  std::string RegisterDump();
+
+  /**
+   * Read the status registers, two ADCP round trips: one block from the
+   * PE (ROOT_CSR through BITSTATUS) and GLOBAL_CSR.  PBIT is worked out
+   * from the BIT status word rather than asking for it again.
+   * @returns false if either read failed.
+   */
+  bool ReadStatus(A429status &s);
+
+  /**
+   * The nidas ARINCHK "STATUS,..." line for s, into buf.
+   * @returns length, as snprintf.
+   */
+  static int FormatStatus(const A429status &s, char *buf, size_t size);
+  /**
+   * Dump the PE and global registers, in block reads.  Text is
+   * "REG_DUMP, offset=value, ..."; binary is "REG_BIN\0" then per range a
+   * big endian (0 PE / 1 global, byte offset, word count) and the words.
+   */
+  std::string RegisterDump(bool binary = false);
   void CheckIRIG();
   void Close();
 
@@ -36,10 +91,42 @@ public:
   void setACserverIP(const char ip[]);
   void setPort(const char port[])	{ _port = atoi(port); }
   void setStatusPort(const char port[])	{ _statusPort = atoi(port); }
+  void setIrigDacFile(const char file[])	{ _irigDacFile = file; }
+
+  /**
+   * Register the ADCP, BIT and IRIG counters kept by Status(), Open(),
+   * Attach() and CalibrateIRIG(), and a histogram of how long Status() takes.
+   */
+  void addMetrics(APMPmetrics &metrics) const;
 
 
 protected:
 
+  /**
+   * ReadDeviceMem32 in pieces of at most ADT_RW_MEM_MAX_SIZE words.  Words
+   * of a failed piece read 0xffffffff.
+   * @returns first failing status, or ADT_SUCCESS.
+   */
+  ADT_L0_UINT32 ReadBlock(ADT_L0_UINT32 devID, ADT_L0_UINT32 offset, ADT_L0_UINT32 *data, int count);
+
+  /**
+   * WriteDeviceMem32 in pieces of at most ADT_RW_MEM_MAX_SIZE words.
+   * @returns first failing status, or ADT_SUCCESS.
+   */
+  ADT_L0_UINT32 WriteBlock(ADT_L0_UINT32 devID, ADT_L0_UINT32 offset, ADT_L0_UINT32 *data, int count);
+
+  /**
+   * Set the IRIG DAC and watch GLOBAL_CSR for lock, for up to a second.
+   * @returns true on lock.
+   */
+  bool TryIrigDac(int value);
+
+  /**
+   * From a DAC value that locks, gallop then bisect in direction dir (+1
+   * or -1) to the last value that still locks.
+   */
+  int IrigDacEdge(int locked, int dir);
+
   // print human readable errors...
   void DisplayInitFailure(ADT_L0_UINT32);
   void DisplayBitFailure(ADT_L0_UINT32);
@@ -59,4 +146,17 @@ protected:
   unsigned int _statusPort;
 
   std::vector<int> _channelList;
+  // SETUP1 and data table pointer of each, as started; see Attach().
+  std::vector<ADT_L0_UINT32> _channelSetup, _channelTable;
+
+  // Last IRIG DAC value that locked, -1 unknown; kept in _irigDacFile
+  // across runs.
+  int		_irigDac;
+  std::string	_irigDacFile;
+
+  // Live copies for APMPmetrics, written only by the control thread.
+  APMPcounter	_opens, _attaches, _pbitFailures, _calibrations, _calibrationFailures;
+  APMPcounter	_adcpTransactions, _adcpRetries, _adcpFailures;	// device totals
+  APMPcounter	_irigDetected, _irigLocked;	// 0 or 1
+  APMPhistogram	_statusTime;
 };
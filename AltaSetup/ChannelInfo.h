@@ -1,3 +1,6 @@
+#ifndef _ChannelInfo_h_
+#define _ChannelInfo_h_
+
 #include <cstdio>
 
 class ChannelInfo
@@ -5,8 +8,8 @@ class ChannelInfo
 public:
   ChannelInfo() : channel(0), speed(0) { }
 
-  unsigned int Channel()	{ return channel; }
-  unsigned int Speed()		{ return speed; }
+  unsigned int Channel() const	{ return channel; }
+  unsigned int Speed() const	{ return speed; }
 
   bool SetChannel(const char info[])
   {
@@ -37,3 +40,5 @@ private:
   unsigned int channel;
   unsigned int speed;
 };
+
+#endif
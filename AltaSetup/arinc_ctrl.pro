@@ -4,17 +4,18 @@
 
 QT += network
 TEMPLATE = app
-CONFIG += console
+CONFIG += console c++17 thread
 
 #DESTDIR = /opt/nidas/bin
 
 INCLUDEPATH += .
 INCLUDEPATH += /opt/local/include/Alta
+INCLUDEPATH += ../rdAltaUDP
 LIBS += -L/opt/local/lib -lADT_L1_Linux_x86_64_v4000 -lADT_L0_Linux_x86_64_v4000
 
 # Input
-HEADERS += A429.h
-SOURCES += ctrl.cc A429.cc
+HEADERS += A429.h ../rdAltaUDP/apmp_metrics.h ../rdAltaUDP/apmp_stats.h
+SOURCES += ctrl.cc A429.cc ../rdAltaUDP/apmp_metrics.cc
 
 target.files = arinc_ctrl
 target.path = /opt/nidas/bin
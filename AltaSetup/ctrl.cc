@@ -15,13 +15,16 @@ static QUdpSocket *udp;
 static QHostAddress acserver(QString("192.168.84.2"));
 static A429 enet1;
 static std::vector<ChannelInfo> channelInfo;
+static APMPmetrics metrics;	// after enet1, so it stops first at exit.
+static int metricsPort = 0;
+static bool binaryDump = false;
 
 
 void processArgs(int argc, char *argv[])
 {
   int opt;
 
-  while((opt = getopt(argc, argv, ":i:s:c:p:u:")) != -1)
+  while((opt = getopt(argc, argv, ":i:s:c:p:u:m:bd:")) != -1)
   {
     ChannelInfo ci;
     switch(opt)
@@ -41,6 +44,15 @@ void processArgs(int argc, char *argv[])
       case 'u':		// ALTASTATUS port.  port to transmit status packet to nidas on
         enet1.setStatusPort(optarg);
         break;
+      case 'd':		// File keeping the last IRIG DAC value that locked.
+        enet1.setIrigDacFile(optarg);
+        break;
+      case 'b':		// Send the register dump to the status port in binary, REG_BIN.
+        binaryDump = true;
+        break;
+      case 'm':		// Serve live metrics on http://127.0.0.1:port/metrics.
+        metricsPort = atoi(optarg);
+        break;
       case ':':
         fprintf(stderr, "option needs a value\n");
         break;
@@ -55,8 +67,11 @@ void processArgs(int argc, char *argv[])
 void sigAction(int sig, siginfo_t* siginfo, void* vptr)
 {
   fprintf(stderr, "arinc_ctrl::SigHandler: signal=%s cleaning up.\n", strsignal(sig));
-  std::string dump = enet1.RegisterDump();
-  fprintf(stderr, "arinc_ctrl::sigAct: %s\n", dump.c_str());
+  std::string dump = enet1.RegisterDump(binaryDump);
+  if (binaryDump)
+    fprintf(stderr, "arinc_ctrl::sigAct: REG_BIN, %zu bytes\n", dump.length());
+  else
+    fprintf(stderr, "arinc_ctrl::sigAct: %s\n", dump.c_str());
   if (enet1.StatusPort() > 0)
     udp->writeDatagram(dump.c_str(), dump.length(), acserver, enet1.StatusPort());
   enet1.Close();
@@ -88,22 +103,26 @@ void setupSignals()
 
 void initializeSequence()
 {
-  enet1.Open();
-
-  while (enet1.isSetup() == false)
+  // Back after a dropout; the device has most likely carried on as we
+  // left it, so take it as it is rather than reset it.
+  if (enet1.isSetup() == false || enet1.Attach() == false)
   {
-    sleep(3);
     enet1.Open();
-  }
 
-  enet1.Status();
-  enet1.CalibrateIRIG();
-  enet1.Status();
+    while (enet1.isSetup() == false)
+    {
+      sleep(3);
+      enet1.Open();
+    }
+
+    enet1.Status();
+    enet1.CalibrateIRIG();
+    enet1.Status();
 
-  for (size_t i = 0; i < channelInfo.size(); ++i)
-    enet1.StartChannel(channelInfo[i].Channel(), channelInfo[i].Speed());
+    enet1.StartChannels(channelInfo);
+  }
 
-  std::string dump = enet1.RegisterDump();
+  std::string dump = enet1.RegisterDump(binaryDump);
   if (enet1.StatusPort() > 0)
     udp->writeDatagram(dump.c_str(), dump.length(), acserver, enet1.StatusPort());
 }
@@ -116,6 +135,13 @@ int main(int argc, char *argv[])
 
   udp = new QUdpSocket();
 
+  if (metricsPort > 0)
+  {
+    enet1.addMetrics(metrics);
+    if (!metrics.serve(metricsPort))
+      exit(1);
+  }
+
   initializeSequence();
 
   int rc;
@@ -5,6 +5,14 @@
 
 #include <stdint.h>
 
+#define APMP_MAX_PAYLOAD	1376	// payloadSize upper limit, in bytes.
+
+// Largest datagram the Alta will send; 8 header words plus the payload.
+#define APMP_MAX_PACKET		(8 * sizeof(uint32_t) + APMP_MAX_PAYLOAD)
+
+// Most RXPs in one packet; payload less the PE and IRIG time words.
+#define APMP_MAX_RXP		((APMP_MAX_PAYLOAD - 16) / 16)
+
 /**
  * Alta APMP packet header.  Data will all be big endian.
  */
@@ -0,0 +1,42 @@
+#ifndef _apmp_capture_h_
+#define _apmp_capture_h_
+
+#include <stdint.h>
+
+/**
+ * APMP capture file layout, written by APMPrecorder (rdudp -w).  All fields
+ * are host (little) endian; the datagrams themselves are stored exactly as
+ * received, big endian.
+ *
+ *   APMP_capture_hdr
+ *   APMP_capture_rec, datagram, zero pad to 8 bytes
+ *   APMP_capture_rec, datagram, zero pad to 8 bytes
+ *   ...
+ *
+ * File space is preallocated, so a capture cut short by a crash ends in
+ * zeros.  Readers resync past anything without the sync word by scanning
+ * 8 byte aligned offsets for the next record that checks out.
+ */
+#define APMP_CAPTURE_MAGIC	0x504D5041	// "APMP"
+#define APMP_CAPTURE_VERSION	1
+#define APMP_CAPTURE_SYNC	0xA17AA17A
+
+typedef struct
+{
+  uint32_t	magic;
+  uint32_t	version;
+  uint32_t	port;		// UDP port captured.
+  uint32_t	reserved;
+} APMP_capture_hdr;
+
+typedef struct
+{
+  uint32_t	sync;		// APMP_CAPTURE_SYNC
+  uint32_t	length;		// Datagram bytes that follow, less padding.
+  uint64_t	hostTime;	// Host receive time, ns since the epoch.
+} APMP_capture_rec;
+
+// Bytes from the start of one record to the next.
+#define APMP_CAPTURE_STRIDE(len)	(sizeof(APMP_capture_rec) + (((len) + 7) & ~7U))
+
+#endif
@@ -0,0 +1,73 @@
+#include "apmp_cvt.h"
+
+/* -------------------------------------------------------------------- */
+ArincCVT::ArincCVT()
+{
+  for (int i = 0; i < NUM_CHANNELS * NUM_LABELS * NUM_SDI; ++i)
+  {
+    _table[i].seq.store(0, std::memory_order_relaxed);
+    _table[i].word.store(0, std::memory_order_relaxed);
+    _table[i].ticks.store(0, std::memory_order_relaxed);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ArincCVT::update(const ArincWords &words)
+{
+  for (int i = 0; i < words.n; ++i)
+  {
+    if (words.channel[i] >= NUM_CHANNELS)
+      continue;
+
+    Entry &e = _table[index(words.channel[i], words.label[i], words.sdi[i])];
+    uint32_t seq = e.seq.load(std::memory_order_relaxed);
+
+    e.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.word.store(words.word[i], std::memory_order_relaxed);
+    e.ticks.store(words.ticks[i], std::memory_order_relaxed);
+    e.seq.store(seq + 2, std::memory_order_release);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+bool ArincCVT::get(int channel, int label, int sdi, Value &out) const
+{
+  if (channel < 0 || channel >= NUM_CHANNELS || label < 0 || label >= NUM_LABELS ||
+      sdi < 0 || sdi >= NUM_SDI)
+    return false;
+
+  const Entry &e = _table[index(channel, label, sdi)];
+  uint32_t seq1, seq2;
+
+  do
+  {
+    seq1 = e.seq.load(std::memory_order_acquire);
+    out.word = e.word.load(std::memory_order_relaxed);
+    out.ticks = e.ticks.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    seq2 = e.seq.load(std::memory_order_relaxed);
+  }
+  while ((seq1 & 1) || seq1 != seq2);
+
+  out.count = seq1 / 2;
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+void ArincCVT::print(FILE *fp) const
+{
+  Value v;
+
+  fprintf(fp, "\n\nCurrent value table (channel label sdi : word ssm PE-usec count)\n");
+  for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+    for (int label = 0; label < NUM_LABELS; ++label)
+      for (int sdi = 0; sdi < NUM_SDI; ++sdi)
+      {
+        get(ch, label, sdi, v);
+        if (v.count == 0)
+          continue;
+        fprintf(fp, "  %d  %04o  %d : 0x%08x  %d  %lld  %u\n", ch, label, sdi,
+		v.word, (v.word >> 29) & 0x03, v.ticks / 50, v.count);
+      }
+}
@@ -0,0 +1,66 @@
+#ifndef _apmp_cvt_h_
+#define _apmp_cvt_h_
+
+#include <atomic>
+#include <cstdio>
+
+#include "arinc_decode.h"
+
+/**
+ * Current value table; latest word for every channel x label x SDI.
+ *
+ * Flat array, 16 bytes an entry, indexed [channel][label][sdi] so all four
+ * SDIs of a label share a cache line.  One writer (the decode loop),
+ * any number of readers; each entry is a small seqlock, seq is odd while
+ * the writer is mid update and the update count is seq / 2.
+ */
+class ArincCVT
+{
+public:
+  static const int NUM_CHANNELS = 8;
+  static const int NUM_LABELS = 256;
+  static const int NUM_SDI = 4;
+
+  struct alignas(16) Entry
+  {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> word;		// Full 32 bit ARINC word, as received.
+    std::atomic<long long> ticks;	// PE time tag, 20ns ticks.
+  };
+
+  /**
+   * Consistent copy of one entry.
+   */
+  struct Value
+  {
+    uint32_t	word;
+    long long	ticks;
+    uint32_t	count;
+  };
+
+  ArincCVT();
+
+  /**
+   * Fold one packet worth of decoded RXPs into the table.  Writer only.
+   */
+  void		update(const ArincWords &words);
+
+  /**
+   * @param label as printed, i.e. already bit reversed; 0310 etc.
+   * @returns false if channel/label/sdi is out of range.
+   */
+  bool		get(int channel, int label, int sdi, Value &out) const;
+
+  /**
+   * Print every entry that has been updated at least once.
+   */
+  void		print(FILE *fp) const;
+
+  static int	index(int channel, int label, int sdi)
+	{ return (channel * NUM_LABELS + label) * NUM_SDI + sdi; }
+
+private:
+  Entry		_table[NUM_CHANNELS * NUM_LABELS * NUM_SDI];
+};
+
+#endif
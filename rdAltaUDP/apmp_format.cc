@@ -0,0 +1,92 @@
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+
+#include "apmp_format.h"
+
+
+/* -------------------------------------------------------------------- */
+void APMPformat::flush()
+{
+  if (_len == 0)
+    return;
+
+  fflush(stdout);
+
+  size_t done = 0;
+  while (done < _len)
+  {
+    ssize_t n = write(_fd, &_buf[done], _len - done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;	// stdout gone; nothing sensible to report it on.
+    }
+    done += n;
+  }
+  _len = 0;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPformat::field(const char *digits, int n, bool negative, int width, char pad, bool left)
+{
+  int fill = width - n - negative;
+
+  if (fill > 0 && !left && pad == ' ')
+    for (; fill > 0; --fill)
+      ch(' ');
+
+  if (negative)
+    ch('-');
+
+  if (fill > 0 && !left)	// Zeros go after the sign.
+    for (; fill > 0; --fill)
+      ch('0');
+
+  str(digits, n);
+
+  for (; fill > 0; --fill)
+    ch(' ');
+}
+
+/* -------------------------------------------------------------------- */
+void APMPformat::dec(long long v, int width, char pad, bool left)
+{
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : v;
+  char tmp[24], *p = tmp + sizeof(tmp);
+
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+
+  field(p, tmp + sizeof(tmp) - p, v < 0, width, pad, left);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPformat::udec(unsigned long long u, int width, char pad, bool left)
+{
+  char tmp[24], *p = tmp + sizeof(tmp);
+
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+
+  field(p, tmp + sizeof(tmp) - p, false, width, pad, left);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPformat::radix(unsigned long long u, int shift, int width)
+{
+  static const char digits[] = "0123456789abcdef";
+  unsigned mask = (1 << shift) - 1;
+  char tmp[24], *p = tmp + sizeof(tmp);
+
+  do {
+    *--p = digits[u & mask];
+    u >>= shift;
+  } while (u);
+
+  field(p, tmp + sizeof(tmp) - p, false, width, '0', false);
+}
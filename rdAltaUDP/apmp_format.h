@@ -0,0 +1,62 @@
+#ifndef _apmp_format_h_
+#define _apmp_format_h_
+
+#include <cstddef>
+#include <cstring>
+
+/**
+ * Allocation free formatter for the rdudp listing.  Fields go straight
+ * into a large buffer, no stdio, and the buffer goes out with one write()
+ * per batch of datagrams.  Each method produces exactly what the printf
+ * conversion named next to it does, so the listing stays byte identical.
+ *
+ * Callers reserve() room for a whole packet up front; flushes then only
+ * happen on line boundaries, so units sharing stdout do not tear lines.
+ */
+class APMPformat
+{
+public:
+  APMPformat(int fd = 1) : _fd(fd), _len(0) { }
+  ~APMPformat()		{ flush(); }
+
+  /**
+   * Make sure there is room for n more bytes, flushing if not.
+   */
+  void	reserve(size_t n)	{ if (_len + n > sizeof(_buf)) flush(); }
+
+  /**
+   * Write out everything buffered.  Anything pending in stdout goes first,
+   * so printf()s elsewhere keep their place.
+   */
+  void	flush();
+
+  size_t size() const		{ return _len; }
+
+  void	ch(char c)		{ _buf[_len++] = c; }
+
+  void	str(const char *s, size_t n)	{ memcpy(&_buf[_len], s, n); _len += n; }
+  void	str(const char *s)	{ str(s, strlen(s)); }
+
+  /**
+   * %d, %u, %lld, %llu with optional width; %0Nd with pad '0', %-Nd with
+   * left set.
+   */
+  void	dec(long long v, int width = 0, char pad = ' ', bool left = false);
+  void	udec(unsigned long long v, int width = 0, char pad = ' ', bool left = false);
+
+  /**
+   * %x, %0Nx and %0No.
+   */
+  void	hex(unsigned long long v, int width = 0)	{ radix(v, 4, width); }
+  void	oct(unsigned long long v, int width = 0)	{ radix(v, 3, width); }
+
+private:
+  void	radix(unsigned long long v, int shift, int width);
+  void	field(const char *digits, int n, bool negative, int width, char pad, bool left);
+
+  int		_fd;
+  size_t	_len;
+  char		_buf[256 * 1024];
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * Synthetic APMP traffic generator, for load testing rdudp / rdudp_epoll
+ * without an Alta unit on the bench.
+ *
+ * Sends datagrams built by APMPsynth to a host and port, 127.0.0.1:56769
+ * by default, in bursts of -b back to back datagrams (one sendmmsg()),
+ * paced to -r datagrams/s or as fast as the socket will take them when -r
+ * is 0.  Datagram loss and reordering are injected here; RXP error bits
+ * and per-channel sequence gaps in APMPsynth.
+ *
+ *   apmpgen -r 0 -n 1000000			line rate, max size packets
+ *   apmpgen -r 2000 -c 0,0,0,1 -x 8		channel 0 three times channel 1
+ *   apmpgen -l 0.001 -o 0.001 -e 0.01		loss, reorder and error bits
+ */
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "apmp_synth.h"
+
+static const int defaultPort = 56769;
+static const int MAX_BURST = 256;
+
+static volatile sig_atomic_t stop = 0;
+
+static void sighandler(int)
+{
+  stop = 1;
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Parse a channel mix, "0-7" or "0,0,1,4-5".
+ */
+static int parseChannels(const char *spec, int *channels, int max)
+{
+  int n = 0;
+  char *end;
+
+  while (*spec && n < max)
+  {
+    int first = strtol(spec, &end, 10), last = first;
+    if (end == spec)
+      return -1;
+    if (*end == '-')
+    {
+      spec = end + 1;
+      last = strtol(spec, &end, 10);
+      if (end == spec)
+        return -1;
+    }
+    for (int c = first; c <= last && n < max; ++c)
+    {
+      if (c < 0 || c > 7)
+        return -1;
+      channels[n++] = c;
+    }
+    spec = *end == ',' ? end + 1 : end;
+    if (*end && *end != ',')
+      return -1;
+  }
+  return n;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+	"Usage: %s [-h host] [-p port] [-r datagrams/s] [-n count] [-b burst]\n"
+	"	[-c channel_mix] [-x rxps] [-L labels] [-l loss] [-o reorder]\n"
+	"	[-e error_bits] [-s seq_gaps] [-S seed]\n"
+	"  -r 0 is as fast as the socket takes them, -n 0 runs until ^C.\n"
+	"  -l -o -e -s are fractions, of datagrams (-l -o) or of RXPs (-e -s).\n", argv0);
+  exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+  const char *host = "127.0.0.1";
+  int port = defaultPort, burst = 1, nRXP = APMP_MAX_RXP, nLabels = 32;
+  double rate = 1000.0, lossRate = 0.0, reorderRate = 0.0, errorRate = 0.0, seqGapRate = 0.0;
+  long long count = 0;
+  unsigned seed = 1;
+  int channels[64], nChannels = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "h:p:r:n:b:c:x:L:l:o:e:s:S:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'h':		// Destination address.
+        host = optarg;
+        break;
+      case 'p':		// Destination port.
+        port = atoi(optarg);
+        break;
+      case 'r':		// Datagrams per second, 0 for line rate.
+        rate = atof(optarg);
+        break;
+      case 'n':		// Datagrams to send, 0 for no limit.
+        count = atoll(optarg);
+        break;
+      case 'b':		// Datagrams per burst.
+        burst = atoi(optarg);
+        if (burst < 1 || burst > MAX_BURST) {
+          fprintf(stderr, "Burst must be 1 to %d.\n", MAX_BURST);
+          exit(1);
+        }
+        break;
+      case 'c':		// Channel mix.
+        if ((nChannels = parseChannels(optarg, channels, 64)) <= 0) {
+          fprintf(stderr, "Bad channel mix '%s', expected e.g. 0-7 or 0,0,1.\n", optarg);
+          exit(1);
+        }
+        break;
+      case 'x':		// RXPs per datagram.
+        nRXP = atoi(optarg);
+        break;
+      case 'L':		// Distinct labels per channel.
+        nLabels = atoi(optarg);
+        break;
+      case 'l':		// Fraction of datagrams not sent.
+        lossRate = atof(optarg);
+        break;
+      case 'o':		// Fraction of datagrams swapped with the next one.
+        reorderRate = atof(optarg);
+        break;
+      case 'e':		// Fraction of RXPs with the error bit set.
+        errorRate = atof(optarg);
+        break;
+      case 's':		// Fraction of RXPs followed by a channel sequence gap.
+        seqGapRate = atof(optarg);
+        break;
+      case 'S':		// Random seed, for reproducible runs.
+        seed = strtoul(optarg, 0, 10);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  APMPsynth synth(seed);
+  if (nChannels > 0)
+    synth.setChannels(channels, nChannels);
+  synth.setRXPs(nRXP);
+  synth.setLabels(nLabels);
+  synth.setErrorRate(errorRate);
+  synth.setSeqGapRate(seqGapRate);
+
+  int fd;
+  struct sockaddr_in addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Bad host address '%s'.\n", host);
+    exit(1);
+  }
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    perror("socket");
+    exit(1);
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    exit(1);
+  }
+
+  signal(SIGINT, sighandler);
+  signal(SIGTERM, sighandler);
+
+  static char packets[MAX_BURST][APMP_MAX_PACKET];
+  static char held[APMP_MAX_PACKET];	// datagram being sent late
+  int heldLen = 0;
+
+  // Send order; a burst plus the held datagram.
+  struct mmsghdr msgs[MAX_BURST + 1];
+  struct iovec iovecs[MAX_BURST + 1];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (int i = 0; i <= MAX_BURST; ++i)
+  {
+    msgs[i].msg_hdr.msg_iov = &iovecs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  // Loss and reordering draw from their own stream so the datagram
+  // contents for a given seed do not depend on -l and -o.
+  unsigned faultSeed = seed;
+
+  long long nBuilt = 0, nSent = 0, nLost = 0, nReordered = 0, nSendErrors = 0;
+  struct timespec start, next, mono, utc;
+  long long interval = rate > 0.0 ? (long long)(burst * 1.0e9 / rate) : 0;	// ns per burst
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  next = start;
+
+  while (!stop && (count == 0 || nBuilt < count))
+  {
+    int nMsgs = 0;
+    bool released = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &utc);
+    long long peTicks = ((long long)mono.tv_sec * 1000000000LL + mono.tv_nsec) / 20;
+
+    for (int i = 0; i < burst && (count == 0 || nBuilt < count); ++i)
+    {
+      int len = synth.build(packets[i], peTicks, utc);
+      ++nBuilt;
+
+      if (lossRate > 0.0 && rand_r(&faultSeed) < lossRate * RAND_MAX) {
+        ++nLost;
+        continue;
+      }
+
+      // Hold this one back until after the next; held[] is still queued
+      // if it was released earlier in this burst.
+      if (heldLen == 0 && !released && reorderRate > 0.0 &&
+          rand_r(&faultSeed) < reorderRate * RAND_MAX)
+      {
+        memcpy(held, packets[i], len);
+        heldLen = len;
+        ++nReordered;
+        continue;
+      }
+
+      iovecs[nMsgs].iov_base = packets[i];
+      iovecs[nMsgs++].iov_len = len;
+
+      if (heldLen > 0) {
+        iovecs[nMsgs].iov_base = held;
+        iovecs[nMsgs++].iov_len = heldLen;
+        heldLen = 0;
+        released = true;
+      }
+    }
+
+    for (int sent = 0; sent < nMsgs; )
+    {
+      int n = sendmmsg(fd, &msgs[sent], nMsgs - sent, 0);
+      if (n < 0) {
+        if (errno == EINTR && !stop)
+          continue;
+        // Nothing listening on loopback shows up as ECONNREFUSED; keep
+        // going, the reader may be started later.
+        ++nSendErrors;
+        break;
+      }
+      sent += n;
+      nSent += n;
+    }
+
+    if (interval > 0)
+    {
+      long long ns = next.tv_nsec + interval;
+      next.tv_sec += ns / 1000000000LL;
+      next.tv_nsec = ns % 1000000000LL;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0) == EINTR && !stop)
+        ;
+    }
+  }
+
+  if (heldLen > 0 && send(fd, held, heldLen, 0) == heldLen)
+    ++nSent;
+
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  double elapsed = (mono.tv_sec - start.tv_sec) + (mono.tv_nsec - start.tv_nsec) * 1.0e-9;
+
+  printf("Sent %lld of %lld datagrams to %s:%d in %.3f s, %.0f datagrams/s, %.0f RXPs/s\n",
+	nSent, nBuilt, host, port, elapsed, nSent / elapsed,
+	nSent * (double)synth.numRXP() / (nBuilt ? nBuilt : 1) / elapsed);
+  printf("  lost=%lld, reordered=%lld, send errors=%lld, RXP error bits=%lld, RXP sequence gaps=%lld\n",
+	nLost, nReordered, nSendErrors, synth.numErrors(), synth.numSeqGaps());
+
+  close(fd);
+  return 0;
+}
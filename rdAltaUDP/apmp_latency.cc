@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <climits>
+
+#include "apmp_latency.h"
+
+static const long long WINDOW_NS = 10LL * 1000000000LL;
+
+
+/* -------------------------------------------------------------------- */
+APMPlatency::APMPlatency() : _maxNs(0), _irigOffsetMin(LONG_MAX),
+	_irigOffsetMax(LONG_MIN), _resets(0)
+{
+  reset();
+}
+
+/* -------------------------------------------------------------------- */
+void APMPlatency::reset()
+{
+  _prevPEns = 0;
+  _winStart = 0;
+  _winMin = LLONG_MAX;
+  _prevWinMin = LLONG_MAX;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPlatency::add(const struct timespec &host, long long peTicks, long irigSecOfDay)
+{
+  long long hostNs = (long long)host.tv_sec * 1000000000LL + host.tv_nsec;
+  long long peNs = peTicks * 20;
+
+  // PE clock went backwards; device was re-initialized, start over.
+  if (peNs < _prevPEns) {
+    reset();
+    ++_resets;
+  }
+  _prevPEns = peNs;
+
+  long long d = hostNs - peNs;
+
+  if (hostNs - _winStart >= WINDOW_NS) {
+    _prevWinMin = _winMin;
+    _winMin = LLONG_MAX;
+    _winStart = hostNs;
+  }
+  if (d < _winMin)
+    _winMin = d;
+
+  long long base = _winMin < _prevWinMin ? _winMin : _prevWinMin;
+  long long lat = d - base;
+
+  _hist.add(lat);
+  if (lat > _maxNs)
+    _maxNs = lat;
+
+  long offset = (host.tv_sec % 86400) - irigSecOfDay;
+  if (offset >= 43200) offset -= 86400;
+  if (offset < -43200) offset += 86400;
+  if (offset < _irigOffsetMin) _irigOffsetMin = offset;
+  if (offset > _irigOffsetMax) _irigOffsetMax = offset;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPlatency::merge(const APMPlatency &later)
+{
+  _hist.merge(later._hist);
+  if (later._maxNs > _maxNs) _maxNs = later._maxNs;
+  if (later._irigOffsetMin < _irigOffsetMin) _irigOffsetMin = later._irigOffsetMin;
+  if (later._irigOffsetMax > _irigOffsetMax) _irigOffsetMax = later._irigOffsetMax;
+  _resets += later._resets;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPlatency::print() const
+{
+  uint64_t count = _hist.count();
+  if (count == 0)
+    return;
+
+  printf("\n\nDevice to host latency above path minimum, %llu packets, mean=%.1f usec, max=%.1f usec, PE resets=%d\n",
+	(unsigned long long)count, (long long)_hist.sumNs() / 1000.0 / count, _maxNs / 1000.0, _resets);
+
+  for (int i = 0; i < NUM_BUCKETS; ++i)
+  {
+    uint64_t n = _hist.bucket(i);
+    if (n == 0)
+      continue;
+    if (i == 0)
+      printf("  %10s < %-8d usec : %llu\n", "", 1, (unsigned long long)n);
+    else
+    if (i == NUM_BUCKETS - 1)
+      printf("  %10d + %-8s usec : %llu\n", 1 << (i - 1), "", (unsigned long long)n);
+    else
+      printf("  %10d - %-8d usec : %llu\n", 1 << (i - 1), 1 << i, (unsigned long long)n);
+  }
+
+  printf("  host - IRIG time of day offset, min=%ld max=%ld sec\n", _irigOffsetMin, _irigOffsetMax);
+}
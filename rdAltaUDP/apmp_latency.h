@@ -0,0 +1,61 @@
+#ifndef _apmp_latency_h_
+#define _apmp_latency_h_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "apmp_metrics.h"
+
+/**
+ * Device to host latency and jitter for one Alta unit.
+ *
+ * The PE clock (20ns ticks) and the host clock have an unknown offset, so
+ * per packet we take d = host receive time - PE time.  The smallest d seen
+ * over the last 10-20 seconds is the no-queueing path; d less that
+ * minimum is the extra delay the packet picked up in the device, network
+ * and kernel.  That goes in a log2 histogram.  The window also follows
+ * the slow drift between the two oscillators.
+ *
+ * The IRIG time of day in the packet is compared to the host time of day,
+ * whole seconds only, to catch a host or IRIG clock that is grossly off.
+ */
+class APMPlatency
+{
+public:
+  APMPlatency();
+
+  /**
+   * @param host kernel receive timestamp (SO_TIMESTAMPNS) of the datagram.
+   * @param peTicks APMP header PE time.
+   * @param irigSecOfDay APMP header IRIG time, seconds since midnight.
+   */
+  void		add(const struct timespec &host, long long peTicks, long irigSecOfDay);
+
+  void		print() const;
+
+  /**
+   * Fold in the histogram from another run over a later part of the
+   * same stream.
+   */
+  void		merge(const APMPlatency &later);
+
+  static const int NUM_BUCKETS = APMPhistogram::NUM_BUCKETS;
+
+  uint64_t	count() const			{ return _hist.count(); }
+  uint64_t	bucket(int i) const		{ return _hist.bucket(i); }
+  const APMPhistogram &histogram() const	{ return _hist; }
+
+private:
+  void		reset();
+
+  APMPhistogram	_hist;
+  long long	_maxNs;
+
+  long long	_prevPEns;
+  long long	_winStart, _winMin, _prevWinMin;	// ns
+
+  long		_irigOffsetMin, _irigOffsetMax;
+  int		_resets;
+};
+
+#endif
@@ -0,0 +1,342 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include "apmp_metrics.h"
+
+static const int SAMPLE_MS = 1000;
+static const int BUFFER_SIZE = 512 * 1024;
+
+
+/* -------------------------------------------------------------------- */
+APMPhistogram::APMPhistogram() : _bucket(), _count(0), _sumNs(0)
+{
+}
+
+/* -------------------------------------------------------------------- */
+void APMPhistogram::add(long long ns)
+{
+  long long usec = ns / 1000;
+  int b = 0;
+  while (usec > 0 && b < NUM_BUCKETS - 1) {
+    usec >>= 1;
+    ++b;
+  }
+  bump(_bucket[b]);
+  bump(_count);
+  bump(_sumNs, ns > 0 ? ns : 0);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPhistogram::merge(const APMPhistogram &later)
+{
+  for (int i = 0; i < NUM_BUCKETS; ++i)
+    bump(_bucket[i], later.bucket(i));
+  bump(_count, later.count());
+  bump(_sumNs, later.sumNs());
+}
+
+
+/* -------------------------------------------------------------------- */
+APMPmetrics::APMPmetrics() : _nEntries(0), _listenfd(-1), _stopfd(-1)
+{
+}
+
+/* -------------------------------------------------------------------- */
+APMPmetrics::~APMPmetrics()
+{
+  stop();
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPmetrics::add(Type type, const char *name, const char *help, const char *labels,
+	const APMPcounter *value, const APMPhistogram *histogram)
+{
+  int n = _nEntries.load(std::memory_order_relaxed);
+  if (n >= MAX_ENTRIES) {
+    fprintf(stderr, "APMPmetrics: registry full, %s not added.\n", name);
+    return false;
+  }
+
+  Entry &e = _entries[n];
+  e.type = type;
+  snprintf(e.name, sizeof(e.name), "%s", name);
+  e.help = help;
+  snprintf(e.labels, sizeof(e.labels), "%s", labels ? labels : "");
+  e.value = value;
+  e.histogram = histogram;
+  e.prevValue = value ? value->load(std::memory_order_relaxed) : 0;
+  e.rate = 0.0;
+
+  _nEntries.store(n + 1, std::memory_order_release);
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPmetrics::counter(const char *name, const char *help, const char *labels,
+	const APMPcounter *value, bool rate)
+{
+  if (!add(COUNTER, name, help, labels, value, 0))
+    return false;
+  if (!rate)
+    return true;
+
+  // apmp_packets_total -> apmp_packets_per_second
+  char rateName[64];
+  int len = strlen(name);
+  if (len > 6 && strcmp(name + len - 6, "_total") == 0)
+    len -= 6;
+  snprintf(rateName, sizeof(rateName), "%.*s_per_second", len, name);
+  return add(RATE, rateName, help, labels, value, 0);
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPmetrics::gauge(const char *name, const char *help, const char *labels,
+	const APMPcounter *value)
+{
+  return add(GAUGE, name, help, labels, value, 0);
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPmetrics::histogram(const char *name, const char *help, const char *labels,
+	const APMPhistogram *value)
+{
+  return add(HISTOGRAM, name, help, labels, 0, value);
+}
+
+/* -------------------------------------------------------------------- */
+int APMPmetrics::format(char *buf, int size)
+{
+  static const char *typeName[] = { "counter", "gauge", "histogram", "gauge" };
+  int n = _nEntries.load(std::memory_order_acquire);
+  bool done[MAX_ENTRIES] = { false };
+  int len = 0;
+
+// Append, stopping quietly at the end of buf.
+#define OUT(...) \
+  do { if (len < size) len += snprintf(buf + len, size - len, __VA_ARGS__); } while (0)
+
+  // The text format wants each family together; units register theirs one
+  // after the other, so gather by name.
+  for (int i = 0; i < n; ++i)
+  {
+    if (done[i])
+      continue;
+
+    const Entry &first = _entries[i];
+    OUT("# HELP %s %s%s\n", first.name, first.help, first.type == RATE ? ", per second" : "");
+    OUT("# TYPE %s %s\n", first.name, typeName[first.type]);
+
+    for (int j = i; j < n; ++j)
+    {
+      const Entry &e = _entries[j];
+      if (done[j] || strcmp(e.name, first.name) != 0)
+        continue;
+      done[j] = true;
+
+      const char *sep = e.labels[0] ? "," : "";
+      switch (e.type)
+      {
+        case COUNTER:
+        case GAUGE:
+          if (e.labels[0])
+            OUT("%s{%s} %llu\n", e.name, e.labels, (unsigned long long)e.value->load(std::memory_order_relaxed));
+          else
+            OUT("%s %llu\n", e.name, (unsigned long long)e.value->load(std::memory_order_relaxed));
+          break;
+        case RATE:
+          if (e.labels[0])
+            OUT("%s{%s} %.1f\n", e.name, e.labels, e.rate);
+          else
+            OUT("%s %.1f\n", e.name, e.rate);
+          break;
+        case HISTOGRAM:
+        {
+          // Read count first; buckets written after it can only add, so
+          // the +Inf bucket may run ahead of _count but never behind.
+          uint64_t count = e.histogram->count(), cumulative = 0;
+          for (int b = 0; b < APMPhistogram::NUM_BUCKETS - 1; ++b)
+          {
+            cumulative += e.histogram->bucket(b);
+            OUT("%s_bucket{%s%sle=\"%g\"} %llu\n", e.name, e.labels, sep,
+		(1 << b) * 1.0e-6, (unsigned long long)cumulative);
+          }
+          cumulative += e.histogram->bucket(APMPhistogram::NUM_BUCKETS - 1);
+          OUT("%s_bucket{%s%sle=\"+Inf\"} %llu\n", e.name, e.labels, sep, (unsigned long long)cumulative);
+          if (e.labels[0]) {
+            OUT("%s_sum{%s} %.9f\n", e.name, e.labels, e.histogram->sumNs() * 1.0e-9);
+            OUT("%s_count{%s} %llu\n", e.name, e.labels, (unsigned long long)count);
+          }
+          else {
+            OUT("%s_sum %.9f\n", e.name, e.histogram->sumNs() * 1.0e-9);
+            OUT("%s_count %llu\n", e.name, (unsigned long long)count);
+          }
+          break;
+        }
+      }
+    }
+  }
+#undef OUT
+
+  return len < size ? len : size - 1;
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPmetrics::serve(int port)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+
+  if ((_listenfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+    perror("APMPmetrics: socket");
+    return false;
+  }
+  setsockopt(_listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (bind(_listenfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(_listenfd, 8) < 0) {
+    fprintf(stderr, "APMPmetrics: 127.0.0.1:%d: %s\n", port, strerror(errno));
+    close(_listenfd);
+    _listenfd = -1;
+    return false;
+  }
+
+  _stopfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  // Signals stay with the application's own threads; a handler that
+  // stops us must never run on ours.
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  _thread = std::thread(&APMPmetrics::run, this);
+  pthread_sigmask(SIG_SETMASK, &old, 0);
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPmetrics::stop()
+{
+  uint64_t one = 1;
+
+  if (_thread.joinable()) {
+    if (write(_stopfd, &one, sizeof(one)) < 0)
+      perror("APMPmetrics: eventfd write");
+    _thread.join();
+  }
+  if (_stopfd >= 0)
+    close(_stopfd);
+  if (_listenfd >= 0)
+    close(_listenfd);
+  _stopfd = _listenfd = -1;
+}
+
+/* -------------------------------------------------------------------- */
+static long long monotonicMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPmetrics::sample(double seconds)
+{
+  int n = _nEntries.load(std::memory_order_acquire);
+
+  for (int i = 0; i < n; ++i)
+  {
+    Entry &e = _entries[i];
+    if (e.type != RATE)
+      continue;
+    uint64_t v = e.value->load(std::memory_order_relaxed);
+    e.rate = (v - e.prevValue) / seconds;
+    e.prevValue = v;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPmetrics::run()
+{
+  struct pollfd fds[2];
+  fds[0].fd = _listenfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = _stopfd;
+  fds[1].events = POLLIN;
+
+  long long lastSample = monotonicMs();
+
+  while (true)
+  {
+    long long now = monotonicMs();
+    if (now - lastSample >= SAMPLE_MS) {
+      sample((now - lastSample) / 1000.0);
+      lastSample = now;
+    }
+
+    int rc = poll(fds, 2, SAMPLE_MS - (int)(now - lastSample));
+    if (rc < 0 && errno != EINTR) {
+      perror("APMPmetrics: poll");
+      break;
+    }
+    if (fds[1].revents & POLLIN)
+      break;
+    if (rc > 0 && (fds[0].revents & POLLIN))
+    {
+      int fd = accept4(_listenfd, 0, 0, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        answer(fd);
+        close(fd);
+      }
+    }
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPmetrics::answer(int fd)
+{
+  // One request per connection, HTTP/1.0 style.  Whatever the path, the
+  // answer is the metrics; a bounded wait for the request line keeps one
+  // idle client from stalling the sampler.
+  char request[2048];
+  struct timeval tv = { 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  int n = 0, rc;
+  while (n < (int)sizeof(request) - 1 && (rc = read(fd, request + n, sizeof(request) - 1 - n)) > 0)
+  {
+    n += rc;
+    request[n] = '\0';
+    if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+      break;
+  }
+  if (n < 4 || strncmp(request, "GET ", 4) != 0)
+    return;
+
+  std::vector<char> body(BUFFER_SIZE);
+  int len = format(&body[0], body.size());
+
+  char header[160];
+  int hlen = snprintf(header, sizeof(header),
+	"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n", len);
+
+  if (send(fd, header, hlen, MSG_NOSIGNAL) != hlen)
+    return;
+  for (int off = 0; off < len; off += rc)
+    if ((rc = send(fd, &body[off], len - off, MSG_NOSIGNAL)) <= 0)
+      return;
+}
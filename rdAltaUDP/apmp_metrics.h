@@ -0,0 +1,122 @@
+#ifndef _apmp_metrics_h_
+#define _apmp_metrics_h_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "apmp_stats.h"
+
+/**
+ * Log2 histogram of a duration, owned and written by one thread like the
+ * other counters; see bump().  Bucket 0 is < 1us, bucket n is
+ * [2^(n-1), 2^n) us; the last is overflow.
+ */
+class APMPhistogram
+{
+public:
+  APMPhistogram();
+
+  void		add(long long ns);
+
+  /**
+   * Fold in a histogram from another run over a later part of the same
+   * stream.
+   */
+  void		merge(const APMPhistogram &later);
+
+  static const int NUM_BUCKETS = 24;
+
+  uint64_t	bucket(int i) const	{ return _bucket[i].load(std::memory_order_relaxed); }
+  uint64_t	count() const		{ return _count.load(std::memory_order_relaxed); }
+  uint64_t	sumNs() const		{ return _sumNs.load(std::memory_order_relaxed); }
+
+private:
+  APMPcounter	_bucket[NUM_BUCKETS];
+  APMPcounter	_count, _sumNs;
+};
+
+
+/**
+ * Registry of live counters, gauges and histograms, served as Prometheus
+ * text on 127.0.0.1:port, e.g. curl localhost:9429/metrics.
+ *
+ * The registry only holds pointers to values the owning threads already
+ * keep as single writer atomics, so nothing on the data path changes and
+ * nothing is locked.  Register everything from one thread, normally
+ * before serve(); each entry is published with a release store of the
+ * count, so registering later is also safe.
+ *
+ * Counters registered with a rate also get a <name>_per_second gauge
+ * (name less any _total), sampled by the server thread once a second.
+ */
+class APMPmetrics
+{
+public:
+  APMPmetrics();
+  ~APMPmetrics();
+
+  /**
+   * @param labels Prometheus label pairs without the braces, e.g.
+   *	"unit=\"56769\",channel=\"4\"", or 0.
+   * @returns false when the registry is full.
+   */
+  bool		counter(const char *name, const char *help, const char *labels,
+			const APMPcounter *value, bool rate = false);
+  bool		gauge(const char *name, const char *help, const char *labels,
+			const APMPcounter *value);
+  bool		histogram(const char *name, const char *help, const char *labels,
+			const APMPhistogram *value);
+
+  /**
+   * Listen on 127.0.0.1:port and answer every HTTP GET with the current
+   * values, from a thread of our own.
+   * @returns false if the socket could not be set up.
+   */
+  bool		serve(int port);
+
+  /**
+   * Stop and join the server thread.
+   */
+  void		stop();
+
+  /**
+   * Prometheus text exposition of every entry into buf.
+   * @returns length, truncated to size - 1.
+   */
+  int		format(char *buf, int size);
+
+  static const int MAX_ENTRIES = 512;
+
+private:
+  enum Type { COUNTER, GAUGE, HISTOGRAM, RATE };
+
+  struct Entry
+  {
+    Type	type;
+    char	name[64];
+    const char	*help;
+    char	labels[64];
+    const APMPcounter	*value;		// COUNTER, GAUGE, RATE (its counter)
+    const APMPhistogram	*histogram;
+
+    // RATE only, server thread only.
+    uint64_t	prevValue;
+    double	rate;
+  };
+
+  bool		add(Type type, const char *name, const char *help, const char *labels,
+			const APMPcounter *value, const APMPhistogram *histogram);
+  void		run();
+  void		sample(double seconds);
+  void		answer(int fd);
+
+  Entry		_entries[MAX_ENTRIES];
+  std::atomic<int> _nEntries;
+
+  int		_listenfd, _stopfd;
+  std::thread	_thread;
+};
+
+#endif
@@ -0,0 +1,570 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "apmp_reader.h"
+#include "apmp_swap.h"
+
+/* -------------------------------------------------------------------- */
+APMPreader::APMPreader() : _recorder(0), _cvt(0), _shm(0), _eu(0), _filter(0), _listing(true), _irigLength(0), _stats(), _timeState(0), _kernelDrops(0),
+	_prevAPMPseqNum(0), _firstAPMPseqNum(0), _prevPE(0), _apmpSeq(32),
+	_reportInterval(0), _nextReport(0), _apmpReported()
+{
+  for (int i = 0; i < APMP_MAX_CHANNELS; ++i)
+  {
+    _prevRXPseqNum[i] = -1;
+    _firstRXPseqNum[i] = -1;
+    _rxpReported[i] = APMPseqCounts();
+  }
+
+  memset(_msgs, 0, sizeof(_msgs));
+  for (int i = 0; i < BATCH_SLOTS; ++i)
+  {
+    _iovecs[i].iov_base = _slots[i];
+    _iovecs[i].iov_len = SLOT_SIZE - 1;
+    _msgs[i].msg_hdr.msg_iov = &_iovecs[i];
+    _msgs[i].msg_hdr.msg_iovlen = 1;
+    _msgs[i].msg_hdr.msg_control = _control[i];
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::printStatistics()
+{
+  APMPstats st;
+  snapshot(st);
+
+  _out.flush();
+
+  // Print statistics...
+  if (_name.size() > 0)
+    printf("\n\n==== Device %s ====", _name.c_str());
+  printf("\n\nTotal number APMP packets = %llu\n", (unsigned long long)st.numAPMPpackets);
+  printf("  mode errors=%llu, status errors=%llu, alignment errors=%llu, sequence errors=%llu\n",
+	(unsigned long long)st.modeError, (unsigned long long)st.statusError,
+	(unsigned long long)st.magicCookieError, (unsigned long long)st.APMPseqError);
+
+  for (int i = 0; i < 8; ++i)
+  {
+    if (st.channel[i].numRXP > 0) {
+      printf("\n\nTotal RXP packets for channel %u = %llu\n", i, (unsigned long long)st.channel[i].numRXP);
+      printf("  decode errors=%llu, sequence errors=%llu\n",
+		(unsigned long long)st.channel[i].decodeError, (unsigned long long)st.channel[i].seqError);
+    }
+  }
+
+  APMPseqCounts c;
+  _apmpSeq.snapshot(c);
+  if (c.received > 0)
+  {
+    printf("\n\nSequence tracking (received, lost, duplicate, reordered, resync : loss)\n");
+    printf("  APMP  %10llu %8llu %8llu %8llu %6llu : %.3f%%\n",
+	(unsigned long long)c.received, (unsigned long long)c.lost, (unsigned long long)c.duplicate,
+	(unsigned long long)c.reordered, (unsigned long long)c.resync, c.lossPercent());
+    for (int i = 0; i < APMP_MAX_CHANNELS; ++i)
+    {
+      _rxpSeq[i].snapshot(c);
+      if (c.received > 0)
+        printf("  ch %-2d %10llu %8llu %8llu %8llu %6llu : %.3f%%\n", i,
+		(unsigned long long)c.received, (unsigned long long)c.lost, (unsigned long long)c.duplicate,
+		(unsigned long long)c.reordered, (unsigned long long)c.resync, c.lossPercent());
+    }
+  }
+
+  if (_kernelDrops > 0)
+    printf("\n\nDatagrams dropped by the kernel, socket buffer full = %u\n", _kernelDrops);
+
+  _latency.print();
+  _time.print();
+
+  if (_batchSize.size() > 0)
+  {
+    printf("\n\nDatagrams per wakeup (recvmmsg batch size : count)\n");
+    for (std::map<int, int>::iterator it = _batchSize.begin(); it != _batchSize.end(); ++it)
+      printf("  %3d : %d\n", it->first, it->second);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPreader::rxpSeqAnomaly(int prevSeqNum, int seqNum)
+{
+  return prevSeqNum != -1 && seqNum != ((prevSeqNum + 1) & 0xFF);	// counter is 8 bit
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::addMetrics(APMPmetrics &m) const
+{
+  char unit[48] = "", labels[64];
+  if (_name.size() > 0)
+    snprintf(unit, sizeof(unit), "unit=\"%s\"", _name.c_str());
+
+  m.counter("apmp_packets_total", "APMP datagrams received", unit, &_stats.numAPMPpackets, true);
+  m.counter("apmp_packets_lost_total", "APMP seqNum gaps, less late arrivals", unit, &_apmpSeq.lostCounter());
+  m.counter("apmp_seq_errors_total", "APMP seqNum not one more than the last", unit, &_stats.APMPseqError);
+  m.counter("apmp_mode_errors_total", "APMP header mode errors", unit, &_stats.modeError);
+  m.counter("apmp_status_errors_total", "APMP header status errors", unit, &_stats.statusError);
+  m.counter("apmp_alignment_errors_total", "APMP magic cookie errors", unit, &_stats.magicCookieError);
+
+  for (int i = 0; i < 8; ++i)
+  {
+    snprintf(labels, sizeof(labels), "%s%schannel=\"%d\"", unit, unit[0] ? "," : "", i);
+    const APMPchannelCounters &c = _stats.channel[i];
+    m.counter("apmp_rxps_total", "RXPs received", labels, &c.numRXP, true);
+    m.counter("apmp_rxps_lost_total", "RXP seqNum gaps, less late arrivals", labels, &_rxpSeq[i].lostCounter());
+    m.counter("apmp_rxp_seq_errors_total", "RXP seqNum not one more than the last", labels, &c.seqError);
+    m.counter("apmp_rxp_decode_errors_total", "RXPs with the error bit set", labels, &c.decodeError);
+  }
+
+  m.histogram("apmp_latency_seconds", "Device to host latency above the path minimum", unit,
+	&_latency.histogram());
+  m.gauge("apmp_irig_state", "PE clock to IRIG: 0 unlocked, 1 locked, 2 holdover", unit, &_timeState);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::snapshot(APMPstats &out) const
+{
+  out.numAPMPpackets = _stats.numAPMPpackets.load(std::memory_order_relaxed);
+  out.modeError = _stats.modeError.load(std::memory_order_relaxed);
+  out.statusError = _stats.statusError.load(std::memory_order_relaxed);
+  out.magicCookieError = _stats.magicCookieError.load(std::memory_order_relaxed);
+  out.APMPseqError = _stats.APMPseqError.load(std::memory_order_relaxed);
+
+  for (int i = 0; i < APMP_MAX_CHANNELS; ++i)
+  {
+    out.channel[i].numRXP = _stats.channel[i].numRXP.load(std::memory_order_relaxed);
+    out.channel[i].decodeError = _stats.channel[i].decodeError.load(std::memory_order_relaxed);
+    out.channel[i].seqError = _stats.channel[i].seqError.load(std::memory_order_relaxed);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::merge(const APMPreader &later)
+{
+  APMPstats st;
+  later.snapshot(st);
+
+  bump(_stats.numAPMPpackets, st.numAPMPpackets);
+  bump(_stats.modeError, st.modeError);
+  bump(_stats.statusError, st.statusError);
+  bump(_stats.magicCookieError, st.magicCookieError);
+  bump(_stats.APMPseqError, st.APMPseqError);
+  _latency.merge(later._latency);
+  _time.merge(later._time);
+  _apmpSeq.merge(later._apmpSeq);
+  for (int channel = 0; channel < APMP_MAX_CHANNELS; ++channel)
+    _rxpSeq[channel].merge(later._rxpSeq[channel]);
+
+  // Sequence checks across the seam; later's first packet had nothing to
+  // compare against.
+  if (later._firstAPMPseqNum > 0)
+  {
+    if (_prevAPMPseqNum > 0 && later._firstAPMPseqNum != _prevAPMPseqNum+1)
+      bump(_stats.APMPseqError);
+    if (_firstAPMPseqNum == 0)
+      _firstAPMPseqNum = later._firstAPMPseqNum;
+    _prevAPMPseqNum = later._prevAPMPseqNum;
+  }
+
+  for (int channel = 0; channel < APMP_MAX_CHANNELS; ++channel)
+  {
+    bump(_stats.channel[channel].numRXP, st.channel[channel].numRXP);
+    bump(_stats.channel[channel].decodeError, st.channel[channel].decodeError);
+    bump(_stats.channel[channel].seqError, st.channel[channel].seqError);
+
+    if (later._firstRXPseqNum[channel] == -1)
+      continue;
+
+    if (rxpSeqAnomaly(_prevRXPseqNum[channel], later._firstRXPseqNum[channel]))
+      bump(_stats.channel[channel].seqError);
+    if (_firstRXPseqNum[channel] == -1)
+      _firstRXPseqNum[channel] = later._firstRXPseqNum[channel];
+    _prevRXPseqNum[channel] = later._prevRXPseqNum[channel];
+  }
+}
+
+/* -------------------------------------------------------------------- */
+int APMPreader::openSocket(int port)
+{
+  int fd, one = 1;
+  struct sockaddr_in addr;
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  // Same as QUdpSocket::ReuseAddressHint | ShareAddress.
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+    perror("setsockopt SO_TIMESTAMPNS");
+  if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+    perror("setsockopt SO_RXQ_OVFL");
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Batch mode; drain everything queued on the socket into the slots with
+ * as few recvmmsg() calls as possible, then process each datagram.
+ */
+int APMPreader::readBatch(int fd)
+{
+  struct timespec now;
+  int nMsgs, total = 0;
+
+  do
+  {
+    // Kernel shrinks msg_controllen to what it filled in.
+    for (int i = 0; i < BATCH_SLOTS; ++i)
+      _msgs[i].msg_hdr.msg_controllen = sizeof(_control[i]);
+
+    nMsgs = recvmmsg(fd, _msgs, BATCH_SLOTS, MSG_DONTWAIT, NULL);
+    if (nMsgs < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("recvmmsg");
+      break;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (int i = 0; i < nMsgs; ++i)
+    {
+      struct timespec ts = now;
+      receiveInfo(_msgs[i].msg_hdr, ts, _kernelDrops);
+
+      int nBytes = _msgs[i].msg_len;
+      _slots[i][nBytes] = '\0';
+      processPacket(_slots[i], nBytes, ts);
+    }
+    total += nMsgs;
+  }
+  while (nMsgs == BATCH_SLOTS);
+
+  if (total > 0) {
+    _batchSize[total]++;
+    if (_listing) {
+      _out.reserve(64);
+      _out.str("\nrecvmmsg wakeup pulled ");
+      _out.dec(total);
+      _out.str(" datagrams\n");
+    }
+  }
+  _out.flush();
+
+  return total;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::receiveInfo(struct msghdr &msg, struct timespec &ts, uint32_t &kernelDrops)
+{
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if (cm->cmsg_level != SOL_SOCKET)
+      continue;
+    if (cm->cmsg_type == SCM_TIMESTAMPNS)
+      memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+    else
+    if (cm->cmsg_type == SO_RXQ_OVFL)
+      memcpy(&kernelDrops, CMSG_DATA(cm), sizeof(kernelDrops));
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::processPacket(char *buffer, int nBytes, const struct timespec &ts)
+{
+  if (_recorder)
+    _recorder->append(buffer, nBytes, ts);
+
+  swapPacket((uint32_t *)buffer, 12);		// APMP header has 12 words to swap.
+
+  const APMP_hdr *hSamp = (const APMP_hdr *)buffer;
+
+  if (_listing) {
+    // Room for the whole packet's listing, so flushes fall between packets.
+    _out.reserve(LISTING_RESERVE + _name.size() + nBytes);
+
+    // Same fields gmtime() would give; time_t has no leap seconds.
+    long tod = ts.tv_sec % 86400;
+    if (_name.size() > 0) {
+      _out.str("\n[");
+      _out.str(_name.data(), _name.size());
+      _out.ch(']');
+    }
+    _out.ch('\n');
+    _out.dec(tod / 3600, 2, '0');
+    _out.ch(':');
+    _out.dec(tod / 60 % 60, 2, '0');
+    _out.ch(':');
+    _out.dec(tod % 60, 2, '0');
+    _out.ch('.');
+    _out.dec(ts.tv_nsec / 1000000);
+    _out.str("  UDP read of nBytes=");
+    _out.dec(nBytes);
+    _out.ch('\n');
+  }
+
+  if (strncmp(buffer, "STATUS", 6) == 0) {
+    if (_listing) {
+      _out.str(buffer, strnlen(buffer, nBytes));
+      _out.ch('\n');
+    }
+    return;
+  }
+
+
+  // Check packet health.
+  bump(_stats.numAPMPpackets);
+  if (hSamp->mode != 1) {
+    bump(_stats.modeError);
+    fprintf(stderr, "Bad mode received, Mode = %d, status = %u, alta = 0x%08x\n",
+      hSamp->mode, hSamp->status & 0xffff, hSamp->alta);
+    return;
+  }
+
+  if ((hSamp->status & 0xFFFF) != 0) {
+    bump(_stats.statusError);
+    fprintf(stderr, "Bad status received, Mode = %d, status = %u, alta = 0x%08x\n",
+      hSamp->mode, hSamp->status & 0xffff, hSamp->alta);
+    return;
+  }
+
+  if (hSamp->alta != 0x414c5441) {
+    bump(_stats.magicCookieError);
+    fprintf(stderr, "Bad magic cookie  received, Mode = %d, status = %u, alta = 0x%08x\n",
+      hSamp->mode, hSamp->status & 0xffff, hSamp->alta);
+    return;
+  }
+  _apmpSeq.add(hSamp->seqNum);
+
+  // Each missing datagram may have held APMP_MAX_RXP of one channel's
+  // RXPs.  A jump of 128 or more reads as a step back on the 8 bit RXP
+  // counter, so when that many could be gone start the channels over.
+  int32_t missing = hSamp->seqNum - _prevAPMPseqNum - 1;
+  if (_prevAPMPseqNum > 0 && missing > 0 && (int64_t)missing * APMP_MAX_RXP >= 127)
+    for (int i = 0; i < APMP_MAX_CHANNELS; ++i)
+      _rxpSeq[i].resync();
+  if (_prevAPMPseqNum > 0 && hSamp->seqNum != _prevAPMPseqNum+1) {
+    bump(_stats.APMPseqError);
+    if (_reportInterval == 0)
+      fprintf(stderr, "APMP sequence anomaly : prevSeq=%d, thisSeq=%d\n", _prevAPMPseqNum+1, hSamp->seqNum);
+  }
+  if (_firstAPMPseqNum == 0)
+    _firstAPMPseqNum = hSamp->seqNum;
+  _prevAPMPseqNum = hSamp->seqNum;
+
+  int nFields = (hSamp->payloadSize - 16) / sizeof(rxp);
+
+  // Never walk past what was actually received.
+  int maxFields = (nBytes - (int)sizeof(APMP_hdr)) / (int)sizeof(rxp);
+  if (nFields > maxFields)
+    nFields = maxFields > 0 ? maxFields : 0;
+
+  // With a filter the RXPs stay big endian; only the ones kept get swapped.
+  if (!_filter)
+    swapPacket((uint32_t *)&buffer[sizeof(APMP_hdr)], nFields * 4);
+
+  long long PE = hSamp->PEtimeHigh; PE = ((PE << 32) | hSamp->PEtimeLow) / 50;
+
+  unsigned long irigSec = decodeIRIG((unsigned char *)&hSamp->IRIGtimeLow);
+  long long peTicks = ((long long)hSamp->PEtimeHigh << 32) | hSamp->PEtimeLow;
+  _latency.add(ts, peTicks, irigSec);
+  _timeState.store(_time.update(peTicks, hSamp->IRIGtimeHigh, hSamp->IRIGtimeLow, ts),
+	std::memory_order_relaxed);
+
+  if (_listing) {
+    _out.str("nFields=");
+    _out.udec((unsigned)nFields, 3);
+    _out.str(" status=0x");
+    _out.hex(hSamp->status, 8);
+    _out.str(" seqNum=");
+    _out.udec(hSamp->seqNum);
+    _out.str(", pSize=");
+    _out.udec(hSamp->payloadSize);
+    _out.str(" - PE ");
+    _out.udec(PE);
+    _out.ch(' ');
+    _out.udec(PE - _prevPE);
+    _out.str(" IRIG julianDay=");
+    _out.hex(hSamp->IRIGtimeHigh);
+    _out.ch(' ');
+    _out.str(irigHHMMSS, _irigLength);
+    _out.ch('\n');
+  }
+
+
+  const rxp *pSamp = (const rxp *) (buffer + sizeof(APMP_hdr));
+  if (_filter)
+    decodeRXPs(pSamp, nFields, *_filter, _words, _kept);
+  else
+    decodeRXPs(pSamp, nFields, _words);
+
+  ArincWords &words = _filter ? _kept : _words;
+  _time.convert(words);
+  if (_eu)
+    _eu->convert(words);
+
+  if (_cvt)
+    _cvt->update(words);
+  if (_shm)
+    _shm->publish(words);
+
+  for (int i = 0; i < _words.n; i++)
+  {
+    int channel = _words.channel[i];
+    int seqNum = _words.seqNum[i];
+    APMPchannelCounters &counters = _stats.channel[channel];
+    bump(counters.numRXP);
+
+    if (_words.error[i]) bump(counters.decodeError);
+
+    _rxpSeq[channel].add(seqNum);
+    if (rxpSeqAnomaly(_prevRXPseqNum[channel], seqNum))
+    {
+      bump(counters.seqError);
+      if (_reportInterval == 0)
+        fprintf(stderr, "RXP sequence anomaly : prevSeq=%d, thisSeq=%d\n",
+		_prevRXPseqNum[channel], seqNum);
+    }
+    if (_firstRXPseqNum[channel] == -1)
+      _firstRXPseqNum[channel] = seqNum;
+    _prevRXPseqNum[channel] = seqNum;
+  }
+
+  for (int i = 0; _listing && i < words.n; i++)
+  {
+    int channel = words.channel[i];
+    long long ttime = words.ticks[i] / 50;	// 20nsec/50Mhz clock ticks to uSecs
+
+    // "  %s.%-6lld  %d  %04o  %d  error=%d\n"; error printed as
+    // control & 0x80000000 always was.
+    if (channel < 8) {
+      _out.str("  ");
+      _out.str(irigHHMMSS, _irigLength);
+      _out.ch('.');
+      _out.dec((ttime-PE)/1000, 6, ' ', true);
+      _out.str("  ");
+      _out.ch('0' + channel);
+      _out.str("  ");
+      _out.oct(words.label[i], 4);
+      _out.str("  ");
+      _out.dec((int)words.raw[i]);
+      _out.str(words.error[i] ? "  error=-2147483648\n" : "  error=0\n");
+    }
+    else {
+      _out.str("received channel number ");
+      _out.dec(channel);
+      _out.str(", outside 0-7, ignoring.\n");
+    }
+  }
+
+  _prevPE = PE;
+
+  if (_reportInterval > 0 && ts.tv_sec >= _nextReport)
+  {
+    if (_nextReport > 0)
+      report(ts);
+    _nextReport = ts.tv_sec + _reportInterval;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * One stderr line of sequence tracking since the last one.
+ */
+void APMPreader::report(const struct timespec &ts)
+{
+  char line[1024];
+  int len = 0;
+  long tod = ts.tv_sec % 86400;
+  APMPseqCounts now, d;
+
+  _apmpSeq.snapshot(now);
+  d = now - _apmpReported;
+  _apmpReported = now;
+
+  len += snprintf(&line[len], sizeof(line) - len, "%02ld:%02ld:%02ld %s%sloss over %ds: APMP %.3f%% lost=%llu dup=%llu reord=%llu",
+	tod / 3600, tod / 60 % 60, tod % 60, _name.c_str(), _name.size() ? " " : "", _reportInterval,
+	d.lossPercent(), (unsigned long long)d.lost, (unsigned long long)d.duplicate,
+	(unsigned long long)d.reordered);
+  if (d.resync > 0)
+    len += snprintf(&line[len], sizeof(line) - len, " resync=%llu", (unsigned long long)d.resync);
+
+  for (int i = 0; i < APMP_MAX_CHANNELS && len < (int)sizeof(line); ++i)
+  {
+    _rxpSeq[i].snapshot(now);
+    d = now - _rxpReported[i];
+    _rxpReported[i] = now;
+    if (d.received > 0)
+      len += snprintf(&line[len], sizeof(line) - len, ", ch%d %.3f%% lost=%llu dup=%llu reord=%llu",
+		i, d.lossPercent(), (unsigned long long)d.lost, (unsigned long long)d.duplicate,
+		(unsigned long long)d.reordered);
+  }
+
+  fprintf(stderr, "%s\n", line);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::seqSnapshot(int channel, APMPseqCounts &out) const
+{
+  if (channel < 0)
+    _apmpSeq.snapshot(out);
+  else
+    _rxpSeq[channel].snapshot(out);
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * %02d for 0 to 165, the most a bad BCD byte decodes to.
+ */
+static inline char *twoDigits(char *p, int v)
+{
+  if (v >= 100) {
+    *p++ = '0' + v / 100;
+    v %= 100;
+  }
+  *p++ = '0' + v / 10;
+  *p++ = '0' + v % 10;
+  return p;
+}
+
+/* -------------------------------------------------------------------- */
+unsigned long APMPreader::decodeIRIG(unsigned char *irig_bcd)
+{
+  int h, m, s;
+
+  h = bcd_to_decimal(irig_bcd[2]);
+  m = bcd_to_decimal(irig_bcd[1]);
+  s = bcd_to_decimal(irig_bcd[0]);
+
+  // "%02d:%02d:%02d"
+  char *p = irigHHMMSS;
+  p = twoDigits(p, h); *p++ = ':';
+  p = twoDigits(p, m); *p++ = ':';
+  p = twoDigits(p, s); *p = '\0';
+  _irigLength = p - irigHHMMSS;
+
+  return h * 3600 + m * 60 + s;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPreader::swapPacket(uint32_t *p, size_t n)
+{
+  swapWords(p, n);
+}
+
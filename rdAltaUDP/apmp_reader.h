@@ -0,0 +1,197 @@
+#ifndef _apmp_reader_h_
+#define _apmp_reader_h_
+
+#include <sys/socket.h>
+#include <time.h>
+
+#include "AltaEnet.h"
+#include "arinc_decode.h"
+#include "apmp_recorder.h"
+#include "apmp_cvt.h"
+#include "apmp_shm.h"
+#include "arinc_eu.h"
+#include "arinc_filter.h"
+#include "apmp_stats.h"
+#include "apmp_latency.h"
+#include "apmp_time.h"
+#include "apmp_seqtrack.h"
+#include "apmp_format.h"
+#include "apmp_metrics.h"
+
+#include <map>
+#include <string>
+
+// Number of datagram slots drained per recvmmsg() call in batch mode.
+static const int BATCH_SLOTS = 64;
+
+// Slot size, APMP_MAX_PACKET rounded up; leaves room to NUL terminate.
+static const int SLOT_SIZE = 2048;
+
+// Control message space per datagram; SO_TIMESTAMPNS and SO_RXQ_OVFL.
+static const int CONTROL_SIZE = CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t));
+
+/**
+ * Decode, check and print the Alta APMP UDP stream.  No Qt in here, so it
+ * can be driven from the Qt event loop (RdUDP) or a plain epoll loop.
+ */
+class APMPreader
+{
+public:
+  APMPreader();
+
+  /**
+   * Open a non-blocking UDP socket bound to INADDR_ANY:port, with kernel
+   * receive timestamps (SO_TIMESTAMPNS) and the socket drop counter
+   * (SO_RXQ_OVFL) turned on.
+   * @returns file descriptor, or -1 on failure.
+   */
+  static int	openSocket(int port);
+
+  /**
+   * Pull the kernel receive time and the running count of datagrams the
+   * kernel dropped for lack of socket buffer out of a received message.
+   * Either is left alone if not present.
+   */
+  static void	receiveInfo(struct msghdr &msg, struct timespec &ts, uint32_t &kernelDrops);
+
+  /**
+   * Drain all datagrams queued on fd with recvmmsg() and process them,
+   * each with its kernel receive timestamp.
+   * @returns number of datagrams read.
+   */
+  int		readBatch(int fd);
+
+  /**
+   * Byte swap, check and print one datagram.  buffer is swapped in place.
+   * @param ts host receive time, CLOCK_REALTIME.
+   */
+  void		processPacket(char *buffer, int nBytes, const struct timespec &ts);
+
+  /**
+   * Write out whatever listing is still buffered.  readBatch() does this
+   * itself; call it after a run of processPacket() calls.
+   */
+  void		flush()				{ _out.flush(); }
+
+  void		printStatistics();
+
+  /**
+   * Copy of the counters.  Lock free, safe to call from a thread other
+   * than the one calling processPacket().
+   */
+  void		snapshot(APMPstats &out) const;
+
+  /**
+   * Add the counts from a reader that processed the packets immediately
+   * following ours, including the sequence checks across the seam.  Used
+   * to combine chunks decoded in parallel.
+   */
+  void		merge(const APMPreader &later);
+
+  /**
+   * Append every datagram, as received, to a capture file.
+   */
+  void		setRecorder(APMPrecorder *r)	{ _recorder = r; }
+
+  /**
+   * Keep the latest value of every channel/label/SDI in this table.
+   */
+  void		setCVT(ArincCVT *cvt)		{ _cvt = cvt; }
+
+  /**
+   * Publish every decoded word to this shared memory ring.
+   */
+  void		setShm(APMPshm *shm)		{ _shm = shm; }
+
+  /**
+   * Convert every word with a label definition to engineering units.
+   */
+  void		setEU(const ArincEU *eu)	{ _eu = eu; }
+
+  /**
+   * Only words passing this filter are decoded, converted, published and
+   * listed.  Channels with no labels in it are not counted at all; the
+   * others still count and sequence check every RXP.
+   */
+  void		setFilter(const ArincFilter *filter)	{ _filter = filter; }
+
+  /**
+   * Name of the unit this reader serves, when there is more than one.
+   * Tags the listing and the statistics.
+   */
+  void		setName(const std::string &name)	{ _name = name; }
+
+  /**
+   * Turn the per packet / per RXP listing on stdout on or off.  Checks and
+   * statistics still run.
+   */
+  void		setListing(bool on)		{ _listing = on; }
+
+  /**
+   * Every this many seconds of receive time, print one line of windowed
+   * loss, duplicate and reorder counts to stderr, in place of a line per
+   * sequence anomaly.  0 turns it off.
+   */
+  void		setReportInterval(int seconds)	{ _reportInterval = seconds; }
+
+  /**
+   * Copy of the sequence tracking counts; channel -1 is the APMP seqNum.
+   */
+  void		seqSnapshot(int channel, APMPseqCounts &out) const;
+
+  /**
+   * Register our live counters, the latency histogram and the PE clock
+   * lock state.  Tagged unit="name" when there is a name.
+   */
+  void		addMetrics(APMPmetrics &metrics) const;
+
+private:
+  static bool	rxpSeqAnomaly(int prevSeqNum, int seqNum);
+  unsigned long	decodeIRIG(unsigned char *);
+  int		bcd_to_decimal(unsigned char x)	{ return x - 6 * (x >> 4); }
+  void		swapPacket(uint32_t *, size_t);
+  void		report(const struct timespec &ts);
+
+  APMPrecorder	*_recorder;
+  ArincCVT	*_cvt;
+  APMPshm	*_shm;
+  const ArincEU	*_eu;
+  const ArincFilter *_filter;
+  bool		_listing;
+  std::string	_name;
+
+  // Listing bytes per packet apart from the name and STATUS text; a full
+  // packet of RXP lines with every field at its widest.
+  static const int LISTING_RESERVE = 256 + APMP_MAX_RXP * 80;
+
+  APMPformat	_out;
+  char		irigHHMMSS[32];
+  int		_irigLength;
+  ArincWords	_words;
+  ArincWords	_kept;		// words passing _filter.
+
+  struct mmsghdr _msgs[BATCH_SLOTS];
+  struct iovec	_iovecs[BATCH_SLOTS];
+  char		_control[BATCH_SLOTS][CONTROL_SIZE];
+  char		_slots[BATCH_SLOTS][SLOT_SIZE];
+
+  APMPcounters	_stats;
+  APMPlatency	_latency;
+  APMPtime	_time;
+  APMPcounter	_timeState;	// APMPtime::State, for metrics
+  uint32_t	_kernelDrops;	// SO_RXQ_OVFL, readBatch() only
+
+  uint32_t	_prevAPMPseqNum, _firstAPMPseqNum;
+  long long	_prevPE;
+  int		_prevRXPseqNum[APMP_MAX_CHANNELS];	// -1 until first seen
+  int		_firstRXPseqNum[APMP_MAX_CHANNELS];
+  std::map<int, int>  _batchSize;	// datagrams per wakeup -> # of wakeups
+
+  APMPseqTracker _apmpSeq;
+  APMPseqTracker _rxpSeq[APMP_MAX_CHANNELS];
+  int		_reportInterval;		// seconds, 0 is off
+  time_t	_nextReport;
+  APMPseqCounts	_apmpReported, _rxpReported[APMP_MAX_CHANNELS];	// at last report
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "apmp_recorder.h"
+
+static const size_t DIRECT_ALIGN = 4096;
+
+
+/* -------------------------------------------------------------------- */
+APMPrecorder::APMPrecorder(const std::string &fileName, int port, long long preallocate, bool direct)
+	: _fd(-1), _direct(direct), _fileName(fileName), _current(0), _nextOffset(0), _done(false),
+	_numRecords(0), _bytesWritten(0), _dropped(0), _writeErrors(0)
+{
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  if (_direct)
+    flags |= O_DIRECT;
+
+  if ((_fd = open(_fileName.c_str(), flags, 0644)) < 0) {
+    fprintf(stderr, "APMPrecorder: open(%s) failed, %s\n", _fileName.c_str(), strerror(errno));
+    return;
+  }
+
+  // KEEP_SIZE so a crash leaves the file at what was actually written.
+  if (preallocate > 0 && fallocate(_fd, FALLOC_FL_KEEP_SIZE, 0, preallocate) < 0)
+    fprintf(stderr, "APMPrecorder: preallocate of %lld bytes failed, %s\n", preallocate, strerror(errno));
+
+  _blocks.resize(NUM_BLOCKS);
+  for (int i = 0; i < NUM_BLOCKS; ++i)
+  {
+    void *p;
+    if (posix_memalign(&p, DIRECT_ALIGN, BLOCK_SIZE) != 0) {
+      perror("APMPrecorder: posix_memalign");
+      exit(1);
+    }
+    _blocks[i].data = (char *)p;
+    _blocks[i].used = _blocks[i].start = 0;
+    _blocks[i].offset = 0;
+    _free.push_back(&_blocks[i]);
+  }
+
+  APMP_capture_hdr hdr;
+  hdr.magic = APMP_CAPTURE_MAGIC;
+  hdr.version = APMP_CAPTURE_VERSION;
+  hdr.port = port;
+  hdr.reserved = 0;
+  put(&hdr, sizeof(hdr));
+
+  _thread = std::thread(&APMPrecorder::writer, this);
+}
+
+APMPrecorder::~APMPrecorder()
+{
+  close();
+
+  for (size_t i = 0; i < _blocks.size(); ++i)
+    free(_blocks[i].data);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::append(const char *datagram, int nBytes, const struct timespec &ts)
+{
+  static const char pad[8] = { 0 };
+
+  if (_fd < 0 || nBytes <= 0)
+    return;
+
+  // The writer hands off an aged _current itself, so the block is only
+  // touched under the lock; it never holds it for long.
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // A record never spans more than two blocks; make sure the second one
+  // is there before we start, otherwise drop it whole.
+  size_t stride = APMP_CAPTURE_STRIDE(nBytes);
+  size_t room = _current ? BLOCK_SIZE - _current->used : 0;
+  if (stride > room && _free.empty()) {
+    ++_dropped;
+    return;
+  }
+
+  APMP_capture_rec rec;
+  rec.sync = APMP_CAPTURE_SYNC;
+  rec.length = nBytes;
+  rec.hostTime = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+  put(&rec, sizeof(rec));
+  put(datagram, nBytes);
+  put(pad, stride - sizeof(rec) - nBytes);
+  ++_numRecords;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::put(const void *p, size_t n)
+{
+  const char *src = (const char *)p;
+
+  while (n > 0)
+  {
+    if (_current == 0)
+      takeBlock();
+
+    size_t len = std::min(n, BLOCK_SIZE - _current->used);
+    memcpy(_current->data + _current->used, src, len);
+    _current->used += len;
+    src += len;
+    n -= len;
+
+    if (_current->used == BLOCK_SIZE)
+      handOff(false);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::takeBlock()
+{
+  _current = _free.front();
+  _free.pop_front();
+  _current->used = _current->start = 0;
+  _current->offset = _nextOffset;
+  _currentStart = std::chrono::steady_clock::now();
+}
+
+/* -------------------------------------------------------------------- */
+/*
+ * early is a partial block going out on age.  With O_DIRECT it is written
+ * padded to a whole sector, so its last partial sector is copied to the
+ * front of a fresh block, which rewrites that sector with the real data
+ * that follows.  No free block for that, and it waits for the next try.
+ */
+void APMPrecorder::handOff(bool early)
+{
+  Block *b = _current;
+  size_t tail = _direct && early ? b->used % DIRECT_ALIGN : 0;
+
+  if (tail && _free.empty())
+    return;
+
+  _full.push_back(b);
+  _current = 0;
+  _nextOffset = b->offset + b->used - tail;
+  _cond.notify_one();
+
+  if (tail) {
+    takeBlock();
+    memcpy(_current->data, b->data + b->used - tail, tail);
+    _current->used = _current->start = tail;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::writer()
+{
+  for (;;)
+  {
+    Block *b;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (_full.empty() && !_done)
+      {
+        if (_cond.wait_for(lock, std::chrono::milliseconds(250)) == std::cv_status::timeout &&
+		_current && _current->used > _current->start &&
+		std::chrono::steady_clock::now() - _currentStart >= std::chrono::seconds(1))
+          handOff(true);
+      }
+      if (_full.empty())
+        break;
+      b = _full.front();
+      _full.pop_front();
+    }
+
+    // O_DIRECT needs whole sectors.  A short block is padded out; the
+    // next block rewrites the padding, or close() truncates it back off.
+    size_t len = b->used;
+    if (_direct && len % DIRECT_ALIGN) {
+      len = (len + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+      memset(b->data + b->used, 0, len - b->used);
+    }
+
+    size_t off = 0;
+    while (off < len)
+    {
+      ssize_t rc = pwrite(_fd, b->data + off, len - off, b->offset + off);
+      if (rc < 0) {
+        if (errno == EINTR)
+          continue;
+        if (_writeErrors++ == 0)
+          fprintf(stderr, "APMPrecorder: write to %s failed, %s\n", _fileName.c_str(), strerror(errno));
+        break;
+      }
+      off += rc;
+    }
+    _bytesWritten = std::max(_bytesWritten, (long long)(b->offset + b->used));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free.push_back(b);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::close()
+{
+  if (_fd < 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_current && _current->used > 0)
+      handOff(false);
+    _done = true;
+    _cond.notify_one();
+  }
+  _thread.join();
+
+  if (ftruncate(_fd, _bytesWritten) < 0)
+    fprintf(stderr, "APMPrecorder: ftruncate(%s) failed, %s\n", _fileName.c_str(), strerror(errno));
+
+  ::close(_fd);
+  _fd = -1;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPrecorder::printStatistics()
+{
+  printf("\n\nRecorded %lld datagrams, %lld bytes to %s\n", _numRecords, _bytesWritten, _fileName.c_str());
+  printf("  dropped (writer behind)=%d, write errors=%d\n", _dropped, _writeErrors);
+}
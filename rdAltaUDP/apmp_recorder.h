@@ -0,0 +1,89 @@
+#ifndef _apmp_recorder_h_
+#define _apmp_recorder_h_
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "apmp_capture.h"
+
+/**
+ * Append raw APMP datagrams to a capture file (see apmp_capture.h).
+ *
+ * append() only copies into an in-memory block; full blocks are handed to
+ * a writer thread.  If the writer falls behind and every block is in use,
+ * the datagram is dropped and counted rather than stalling the receiver.
+ * The writer also takes any block that has held data for a second, so a
+ * crash or a quiet bus loses at most that much.
+ */
+class APMPrecorder
+{
+public:
+  /**
+   * @param preallocate bytes of file space to reserve up front.
+   * @param direct use O_DIRECT, bypassing the page cache.
+   */
+  APMPrecorder(const std::string &fileName, int port, long long preallocate, bool direct);
+  ~APMPrecorder();
+
+  bool		isOpen()	{ return _fd >= 0; }
+
+  /**
+   * Called from the receive thread, before the datagram is swapped.
+   */
+  void		append(const char *datagram, int nBytes, const struct timespec &ts);
+
+  /**
+   * Hand the current block to the writer and wait for everything to hit
+   * the file.
+   */
+  void		close();
+
+  void		printStatistics();
+
+private:
+  struct Block
+  {
+    char	*data;
+    size_t	used;
+    size_t	start;		// Leading bytes already in the file.
+    off_t	offset;		// File offset of data[0].
+  };
+
+  void		writer();
+
+  // Under _mutex.
+  void		put(const void *p, size_t n);
+  void		takeBlock();
+  void		handOff(bool early);
+
+  static const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+  static const int NUM_BLOCKS = 8;
+
+  int		_fd;
+  bool		_direct;
+  std::string	_fileName;
+
+  std::vector<Block> _blocks;
+  Block		*_current;
+  std::chrono::steady_clock::time_point _currentStart;
+  off_t		_nextOffset;
+
+  std::mutex	_mutex;
+  std::condition_variable _cond;
+  std::deque<Block *> _free, _full;
+  bool		_done;
+  std::thread	_thread;
+
+  long long	_numRecords, _bytesWritten;
+  int		_dropped, _writeErrors;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "apmp_ring.h"
+
+
+/* -------------------------------------------------------------------- */
+APMPring::APMPring(int nSlots) : _head(0), _tail(0), _sleeping(false), _overruns(0), _kernelDrops(0), _highWater(0)
+{
+  size_t n = 1;
+  while (n < (size_t)nSlots)
+    n <<= 1;
+  _mask = n - 1;
+
+  _slots = new Slot[n];
+
+  memset(_msgs, 0, sizeof(_msgs));
+  for (int i = 0; i < BATCH_SLOTS; ++i)
+  {
+    _msgs[i].msg_hdr.msg_iov = &_iovecs[i];
+    _msgs[i].msg_hdr.msg_iovlen = 1;
+    _msgs[i].msg_hdr.msg_control = _control[i];
+  }
+
+  if ((_wakefd = eventfd(0, EFD_NONBLOCK)) < 0) {
+    perror("APMPring: eventfd");
+    exit(1);
+  }
+}
+
+APMPring::~APMPring()
+{
+  close(_wakefd);
+  delete [] _slots;
+}
+
+/* -------------------------------------------------------------------- */
+int APMPring::receive(int fd)
+{
+  struct timespec now;
+  int nMsgs, total = 0;
+  uint32_t drops = _kernelDrops.load(std::memory_order_relaxed);
+
+  do
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    size_t nFree = size() - (head - tail);
+    int nWant = nFree < (size_t)BATCH_SLOTS ? nFree : BATCH_SLOTS;
+    bool overrun = (nWant == 0);
+
+    // Ring full; keep the socket drained so the loss is ours, and counted.
+    if (overrun)
+      nWant = BATCH_SLOTS;
+
+    for (int i = 0; i < nWant; ++i)
+    {
+      _iovecs[i].iov_base = overrun ? _scratch : _slots[(head + i) & _mask].data;
+      _iovecs[i].iov_len = SLOT_SIZE - 1;
+      _msgs[i].msg_hdr.msg_controllen = sizeof(_control[i]);
+    }
+
+    nMsgs = recvmmsg(fd, _msgs, nWant, MSG_DONTWAIT, NULL);
+    if (nMsgs < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        perror("recvmmsg");
+      break;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (int i = 0; i < nMsgs; ++i)
+    {
+      struct timespec ts = now;
+      APMPreader::receiveInfo(_msgs[i].msg_hdr, ts, drops);
+      if (overrun)
+        continue;
+
+      Slot &slot = _slots[(head + i) & _mask];
+      slot.ts = ts;
+      slot.nBytes = _msgs[i].msg_len;
+      slot.data[slot.nBytes] = '\0';
+    }
+
+    if (overrun)
+      _overruns.store(_overruns.load(std::memory_order_relaxed) + nMsgs, std::memory_order_relaxed);
+    else
+    {
+      // seq_cst pairs with the consumer in wait(); either it sees the new
+      // head, or we see it sleeping.
+      _head.store(head + nMsgs, std::memory_order_seq_cst);
+      if (head + nMsgs - tail > _highWater.load(std::memory_order_relaxed))
+        _highWater.store(head + nMsgs - tail, std::memory_order_relaxed);
+    }
+
+    total += nMsgs;
+  }
+  while (nMsgs > 0);
+
+  _kernelDrops.store(drops, std::memory_order_relaxed);
+
+  if (total > 0 && _sleeping.load(std::memory_order_seq_cst))
+  {
+    uint64_t one = 1;
+    if (write(_wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+      perror("APMPring: eventfd write");
+  }
+
+  return total;
+}
+
+/* -------------------------------------------------------------------- */
+int APMPring::consume(APMPreader *reader)
+{
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  size_t head = _head.load(std::memory_order_acquire);
+  int n = 0;
+
+  for (; tail != head; ++tail, ++n)
+  {
+    Slot &slot = _slots[tail & _mask];
+    reader->processPacket(slot.data, slot.nBytes, slot.ts);
+
+    // Give slots back as we go so the producer is not held off by a
+    // whole batch of slow output.
+    _tail.store(tail + 1, std::memory_order_release);
+  }
+
+  if (n > 0)
+    reader->flush();
+
+  return n;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPring::wait(int stopfd)
+{
+  _sleeping.store(true, std::memory_order_seq_cst);
+
+  if (_head.load(std::memory_order_seq_cst) == _tail.load(std::memory_order_relaxed))
+  {
+    struct pollfd fds[2];
+    fds[0].fd = _wakefd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopfd;
+    fds[1].events = POLLIN;
+
+    if (poll(fds, 2, -1) > 0 && (fds[0].revents & POLLIN))
+    {
+      uint64_t count;
+      if (read(_wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("APMPring: eventfd read");
+    }
+  }
+
+  _sleeping.store(false, std::memory_order_relaxed);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPring::printStatistics()
+{
+  printf("\n\nReceive ring: %zu slots, high water=%zu, overruns (decode behind)=%llu, kernel drops=%u\n",
+	size(), highWater(), (unsigned long long)overruns(), kernelDrops());
+}
@@ -0,0 +1,82 @@
+#ifndef _apmp_ring_h_
+#define _apmp_ring_h_
+
+#include <atomic>
+#include <vector>
+
+#include "apmp_reader.h"
+
+/**
+ * Lock free single producer / single consumer ring of datagram slots
+ * between the network thread and the decode/output thread.
+ *
+ * The network thread recvmmsg()s straight into free slots, so a datagram
+ * is never copied.  When the ring is full it keeps draining the socket
+ * into a scratch slot and counts the overrun; a slow consumer shows up as
+ * ring overruns instead of silent kernel drops.  Kernel drops (socket
+ * buffer full, SO_RXQ_OVFL) are counted as well.
+ */
+class APMPring
+{
+public:
+  struct Slot
+  {
+    struct timespec ts;		// Kernel receive time.
+    int		nBytes;
+    char	data[SLOT_SIZE];
+  };
+
+  /**
+   * @param nSlots rounded up to a power of two.
+   */
+  APMPring(int nSlots);
+  ~APMPring();
+
+  /**
+   * Producer.  Drain everything queued on fd into the ring.
+   * @returns number of datagrams read, including overruns.
+   */
+  int		receive(int fd);
+
+  /**
+   * Consumer.  Hand every queued datagram to reader->processPacket().
+   * @returns number of datagrams processed.
+   */
+  int		consume(APMPreader *reader);
+
+  /**
+   * Consumer.  Block until there is something in the ring or stopfd
+   * becomes readable.
+   */
+  void		wait(int stopfd);
+
+  uint64_t	overruns() const	{ return _overruns.load(std::memory_order_relaxed); }
+  uint32_t	kernelDrops() const	{ return _kernelDrops.load(std::memory_order_relaxed); }
+  size_t	highWater() const	{ return _highWater.load(std::memory_order_relaxed); }
+  size_t	size() const		{ return _mask + 1; }
+  const std::atomic<uint64_t> &overrunCounter() const	{ return _overruns; }
+
+  void		printStatistics();
+
+private:
+  Slot		*_slots;
+  size_t	_mask;
+
+  // Producer and consumer indices on their own cache lines.
+  alignas(64) std::atomic<size_t> _head;	// next slot to fill
+  alignas(64) std::atomic<size_t> _tail;	// next slot to consume
+  alignas(64) std::atomic<bool> _sleeping;	// consumer is in wait()
+  int		_wakefd;
+
+  // Producer only.
+  struct mmsghdr _msgs[BATCH_SLOTS];
+  struct iovec	_iovecs[BATCH_SLOTS];
+  char		_control[BATCH_SLOTS][CONTROL_SIZE];
+  char		_scratch[SLOT_SIZE];
+
+  std::atomic<uint64_t> _overruns;
+  std::atomic<uint32_t> _kernelDrops;
+  std::atomic<size_t> _highWater;
+};
+
+#endif
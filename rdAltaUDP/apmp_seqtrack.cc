@@ -0,0 +1,131 @@
+#include "apmp_seqtrack.h"
+
+
+/* -------------------------------------------------------------------- */
+APMPseqTracker::APMPseqTracker(int bits) : _mask(bits >= 32 ? 0xFFFFFFFF : (1U << bits) - 1),
+	_started(false), _resyncNext(false), _first(0), _highest(0), _seen(0), _holes(0),
+	_received(0), _lost(0), _duplicate(0), _reordered(0), _resync(0)
+{
+}
+
+/* -------------------------------------------------------------------- */
+void APMPseqTracker::advance(uint64_t delta)
+{
+  if (delta >= WINDOW) {
+    _seen = 1;
+    _holes = ~1ULL;
+  }
+  else {
+    _seen = (_seen << delta) | 1;
+    _holes = (_holes << delta) | ((1ULL << delta) - 2);
+  }
+  bump(_lost, delta - 1);
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPseqTracker::add(uint32_t seq)
+{
+  bump(_received);
+  seq &= _mask;
+
+  if (!_started) {
+    _started = true;
+    _first = _highest = seq;
+    _seen = 1;
+    _holes = 0;
+    return false;
+  }
+
+  if (_resyncNext) {
+    _resyncNext = false;
+    bump(_resync);
+    _highest = seq;
+    _seen = 1;
+    _holes = 0;
+    return true;
+  }
+
+  // Signed distance from the highest seen, modulo the counter size.
+  uint64_t modulus = (uint64_t)_mask + 1;
+  int64_t delta = (seq - _highest) & _mask;
+  if ((uint64_t)delta >= modulus / 2)
+    delta -= modulus;
+
+  if (delta == 1) {
+    _highest = seq;
+    _seen = (_seen << 1) | 1;
+    _holes <<= 1;
+    return false;
+  }
+
+  if (delta > 1) {
+    _highest = seq;
+    advance(delta);
+  }
+  else
+  if (-delta < WINDOW)
+  {
+    uint64_t bit = 1ULL << -delta;
+    if (_seen & bit)
+      bump(_duplicate);
+    else {
+      _seen |= bit;
+      bump(_reordered);
+      if (_holes & bit) {
+        _holes &= ~bit;
+        _lost.store(_lost.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);	// counted lost when skipped
+      }
+    }
+  }
+  else {
+    bump(_resync);
+    _highest = seq;
+    _seen = 1;
+    _holes = 0;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPseqTracker::snapshot(APMPseqCounts &out) const
+{
+  out.received = _received.load(std::memory_order_relaxed);
+  out.lost = _lost.load(std::memory_order_relaxed);
+  out.duplicate = _duplicate.load(std::memory_order_relaxed);
+  out.reordered = _reordered.load(std::memory_order_relaxed);
+  out.resync = _resync.load(std::memory_order_relaxed);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPseqTracker::merge(const APMPseqTracker &later)
+{
+  APMPseqCounts c;
+  later.snapshot(c);
+
+  bump(_received, c.received);
+  bump(_lost, c.lost);
+  bump(_duplicate, c.duplicate);
+  bump(_reordered, c.reordered);
+  bump(_resync, c.resync);
+
+  if (!later._started)
+    return;
+
+  if (!_started) {
+    _started = true;
+    _first = later._first;
+  }
+  else
+  {
+    // Only a clean jump ahead across the seam can be counted; anything
+    // else needs the other side's window.
+    uint32_t delta = (later._first - _highest) & _mask;
+    if (delta > 1 && delta < (_mask >> 1))
+      bump(_lost, delta - 1);
+  }
+  _highest = later._highest;
+  _seen = later._seen;
+  _holes = later._holes;
+  _resyncNext = later._resyncNext;
+}
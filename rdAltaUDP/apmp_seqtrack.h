@@ -0,0 +1,94 @@
+#ifndef _apmp_seqtrack_h_
+#define _apmp_seqtrack_h_
+
+#include <stdint.h>
+
+#include "apmp_stats.h"
+
+/**
+ * Plain copy of a tracker's counts.
+ */
+struct APMPseqCounts
+{
+  uint64_t	received, lost, duplicate, reordered, resync;
+
+  /**
+   * Lost as a percentage of what should have arrived.
+   */
+  double	lossPercent() const
+	{ uint64_t n = received - duplicate + lost; return n ? 100.0 * lost / n : 0.0; }
+
+  /**
+   * Counts over an interval.  Lost can go down, when words counted lost
+   * in an earlier interval arrive late; that shows as none lost.
+   */
+  APMPseqCounts	operator-(const APMPseqCounts &b) const
+	{ APMPseqCounts d = { received - b.received, lost > b.lost ? lost - b.lost : 0,
+		duplicate - b.duplicate, reordered - b.reordered, resync - b.resync }; return d; }
+};
+
+/**
+ * Sliding window sequence number tracker, for the 8 bit per-channel RXP
+ * counter or the 32 bit APMP seqNum.
+ *
+ * A 64 bit map records which of the last 64 sequence numbers below the
+ * highest seen have arrived, and a second which of them were skipped by a
+ * jump ahead and so counted lost.  One of those turning up late fills its
+ * hole and moves from lost to reordered; one already in the map is a
+ * duplicate; anything else in the window (before the first seq, or from
+ * before a resync) is reordered, nothing having been counted lost for it.
+ * Anything further back than the window (a unit restart for the 32 bit
+ * count) starts the window over and counts a resync.  Rollover is just
+ * modular arithmetic, no special case.
+ *
+ * Distances are taken modulo the counter, so a jump ahead of half the
+ * counter or more reads as a step back: for the 8 bit RXP counter, 128.
+ * The tracker can't tell; whoever knows the counter may have moved that
+ * far (APMPreader, when datagrams went missing) calls resync().
+ *
+ * Counts are single writer atomics, see bump(); snapshot() is safe from
+ * another thread.
+ */
+class APMPseqTracker
+{
+public:
+  APMPseqTracker(int bits = 8);
+
+  /**
+   * @returns true if seq was not the next one expected.
+   */
+  bool		add(uint32_t seq);
+
+  /**
+   * Start the window over at the next seq, counting a resync, instead of
+   * trusting its distance from the last one.
+   */
+  void		resync()			{ _resyncNext = _started; }
+
+  void		snapshot(APMPseqCounts &out) const;
+
+  const APMPcounter &lostCounter() const	{ return _lost; }
+
+  /**
+   * Fold in a tracker that saw the sequence numbers immediately following
+   * ours, including the gap, if any, across the seam.
+   */
+  void		merge(const APMPseqTracker &later);
+
+  static const int WINDOW = 64;
+
+private:
+  void		advance(uint64_t delta);
+
+  uint32_t	_mask;
+  bool		_started;
+  bool		_resyncNext;
+  uint32_t	_first;		// first seq seen, for merge()
+  uint32_t	_highest;	// highest seq seen, modulo _mask + 1
+  uint64_t	_seen;		// bit i set: _highest - i arrived
+  uint64_t	_holes;		// bit i set: _highest - i skipped, counted lost
+
+  APMPcounter	_received, _lost, _duplicate, _reordered, _resync;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "apmp_shm.h"
+
+static size_t roundPage(size_t n)	{ return (n + 4095) & ~(size_t)4095; }
+
+
+/* -------------------------------------------------------------------- */
+std::string APMPshm::segmentName(int port)
+{
+  return "/apmp." + std::to_string(port);
+}
+
+/* -------------------------------------------------------------------- */
+APMPshm::APMPshm(int port, int ringSlots) : _name(segmentName(port)), _size(0), _hdr(0), _ring(0), _cvt(0)
+{
+  // Readers keep a packet's worth of slack; see APMPshmReader::peek().
+  uint64_t slots = 1024;
+  while (slots < (uint64_t)ringSlots)
+    slots <<= 1;
+  _mask = slots - 1;
+
+  size_t ringOffset = roundPage(sizeof(APMPshmHeader));
+  size_t cvtOffset = ringOffset + roundPage(slots * sizeof(APMPshmWord));
+  _size = cvtOffset + roundPage(sizeof(ArincCVT));
+
+  // Start from a fresh segment; readers still mapped to an old one see
+  // its closed flag.
+  shm_unlink(_name.c_str());
+  int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "APMPshm: shm_open(%s) failed, %s\n", _name.c_str(), strerror(errno));
+    return;
+  }
+
+  if (ftruncate(fd, _size) < 0) {
+    fprintf(stderr, "APMPshm: ftruncate(%s) failed, %s\n", _name.c_str(), strerror(errno));
+    close(fd);
+    shm_unlink(_name.c_str());
+    return;
+  }
+
+  void *base = mmap(0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "APMPshm: mmap(%s) failed, %s\n", _name.c_str(), strerror(errno));
+    shm_unlink(_name.c_str());
+    return;
+  }
+
+  _ring = (APMPshmWord *)((char *)base + ringOffset);
+  _cvt = new ((char *)base + cvtOffset) ArincCVT();
+
+  APMPshmHeader *hdr = new (base) APMPshmHeader();
+  hdr->version = APMPshmHeader::VERSION;
+  hdr->ringSlots = slots;
+  hdr->wordSize = sizeof(APMPshmWord);
+  hdr->ringOffset = ringOffset;
+  hdr->cvtOffset = cvtOffset;
+  hdr->port = port;
+  hdr->pid = getpid();
+  hdr->head.store(0, std::memory_order_relaxed);
+  hdr->packets.store(0, std::memory_order_relaxed);
+  hdr->updateNs.store(0, std::memory_order_relaxed);
+  hdr->closed.store(0, std::memory_order_relaxed);
+
+  // Magic last; a reader attaching mid setup sees a segment not ready yet.
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->magic = APMPshmHeader::MAGIC;
+  _hdr = hdr;
+}
+
+APMPshm::~APMPshm()
+{
+  if (_hdr == 0)
+    return;
+
+  _hdr->closed.store(1, std::memory_order_release);
+  munmap(_hdr, _size);
+  shm_unlink(_name.c_str());
+}
+
+/* -------------------------------------------------------------------- */
+void APMPshm::publish(const ArincWords &words)
+{
+  uint64_t head = _hdr->head.load(std::memory_order_relaxed);
+
+  for (int i = 0; i < words.n; ++i)
+  {
+    APMPshmWord &w = _ring[(head + i) & _mask];
+    w.ticks = words.ticks[i];
+    w.utc = words.utc[i];
+    w.word = words.word[i];
+    w.channel = words.channel[i];
+    w.label = words.label[i];
+    w.sdi = words.sdi[i];
+    w.ssm = words.ssm[i];
+    w.error = words.error[i];
+    w.seqNum = words.seqNum[i];
+    w.def = words.def[i];
+    w.value = words.value[i];
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  _hdr->updateNs.store((long long)now.tv_sec * 1000000000LL + now.tv_nsec, std::memory_order_relaxed);
+  _hdr->packets.store(_hdr->packets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  _hdr->head.store(head + words.n, std::memory_order_release);
+}
+
+
+/* -------------------------------------------------------------------- */
+APMPshmReader::APMPshmReader() : _size(0), _hdr(0), _ring(0), _cvt(0), _mask(0), _cursor(0), _missed(0)
+{
+}
+
+APMPshmReader::~APMPshmReader()
+{
+  if (_hdr)
+    munmap((void *)_hdr, _size);
+}
+
+/* -------------------------------------------------------------------- */
+bool APMPshmReader::attach(int port)
+{
+  std::string name = APMPshm::segmentName(port);
+  struct stat st;
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "APMPshmReader: shm_open(%s) failed, %s\n", name.c_str(), strerror(errno));
+    return false;
+  }
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(APMPshmHeader)) {
+    fprintf(stderr, "APMPshmReader: %s is not ready.\n", name.c_str());
+    close(fd);
+    return false;
+  }
+
+  void *base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "APMPshmReader: mmap(%s) failed, %s\n", name.c_str(), strerror(errno));
+    return false;
+  }
+
+  const APMPshmHeader *hdr = (const APMPshmHeader *)base;
+  if (hdr->magic != APMPshmHeader::MAGIC || hdr->version != APMPshmHeader::VERSION ||
+      hdr->wordSize != sizeof(APMPshmWord) || hdr->cvtOffset + sizeof(ArincCVT) > (uint64_t)st.st_size)
+  {
+    fprintf(stderr, "APMPshmReader: %s is not an APMP segment this reader understands.\n", name.c_str());
+    munmap(base, st.st_size);
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  _size = st.st_size;
+  _hdr = hdr;
+  _ring = (const APMPshmWord *)((const char *)base + hdr->ringOffset);
+  _cvt = (const ArincCVT *)((const char *)base + hdr->cvtOffset);
+  _mask = hdr->ringSlots - 1;
+  _cursor = hdr->head.load(std::memory_order_acquire);
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+int APMPshmReader::peek(const APMPshmWord *&p)
+{
+  uint64_t head = _hdr->head.load(std::memory_order_acquire);
+  uint64_t slots = _mask + 1;
+
+  // Lapped; the oldest still intact is a packet past head - slots, since
+  // the writer fills a packet's worth before moving head.
+  if (head - _cursor > slots - APMP_MAX_RXP) {
+    uint64_t skip = head - (slots - APMP_MAX_RXP) - _cursor;
+    _missed += skip;
+    _cursor += skip;
+  }
+
+  uint64_t n = head - _cursor;
+  uint64_t toEnd = slots - (_cursor & _mask);
+  if (n > toEnd)
+    n = toEnd;
+
+  p = &_ring[_cursor & _mask];
+  return n;
+}
+
+/* -------------------------------------------------------------------- */
+int APMPshmReader::release(int n)
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t head = _hdr->head.load(std::memory_order_relaxed);
+  uint64_t slots = _mask + 1;
+
+  // The writer may be up to a packet past head, over slots behind it.
+  int bad = 0;
+  if (head + APMP_MAX_RXP > _cursor + slots)
+    bad = head + APMP_MAX_RXP - (_cursor + slots);
+  if (bad > n)
+    bad = n;
+
+  _missed += bad;
+  _cursor += n;
+  return bad;
+}
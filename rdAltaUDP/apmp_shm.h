@@ -0,0 +1,144 @@
+#ifndef _apmp_shm_h_
+#define _apmp_shm_h_
+
+#include <atomic>
+#include <string>
+
+#include "arinc_decode.h"
+#include "apmp_cvt.h"
+
+/**
+ * Decoded ARINC words published through POSIX shared memory, so other
+ * processes on the DSM (nidas, quick look displays) can attach instead of
+ * each opening its own socket on the APMP port and decoding every packet
+ * again.
+ *
+ * One segment per Alta unit, /apmp.<port>: a header, a ring of decoded
+ * words and an ArincCVT.  One writer; any number of readers, each with
+ * its own cursor, that never write to the segment.  The ring overwrites;
+ * a reader that falls more than a ring behind skips ahead and counts the
+ * words it missed.  The CVT is the same seqlock table as in process.
+ */
+
+/**
+ * One decoded RXP, as published.
+ */
+struct APMPshmWord
+{
+  long long	ticks;		// PE time tag, 20ns ticks.
+  long long	utc;		// UTC ns, see APMPtime; 0 unlocked.
+  uint32_t	word;		// Whole ARINC word, as received.
+  uint8_t	channel;
+  uint8_t	label;		// bit reversed, print with %04o
+  uint8_t	sdi;
+  uint8_t	ssm;
+  uint8_t	error;
+  uint8_t	seqNum;
+  uint16_t	def;		// ArincEU definition, 0 is none.
+  float		value;		// engineering units, when def != 0.
+};
+
+static_assert(sizeof(APMPshmWord) == 32, "APMPshmWord layout");
+
+struct APMPshmHeader
+{
+  static const uint32_t MAGIC = 0x534D5041;	// "APMS"
+  static const uint32_t VERSION = 2;
+
+  uint32_t	magic;
+  uint32_t	version;
+  uint32_t	ringSlots;	// power of two
+  uint32_t	wordSize;	// sizeof(APMPshmWord)
+  uint64_t	ringOffset;	// from the start of the segment
+  uint64_t	cvtOffset;
+  int32_t	port;
+  int32_t	pid;		// writer
+
+  alignas(64) std::atomic<uint64_t> head;	// words ever published
+  std::atomic<uint64_t> packets;		// packets ever published
+  std::atomic<long long> updateNs;		// CLOCK_REALTIME of the last publish
+  std::atomic<uint32_t> closed;			// writer has gone away
+};
+
+
+/**
+ * Writer side; creates /apmp.<port>.
+ */
+class APMPshm
+{
+public:
+  APMPshm(int port, int ringSlots = 65536);
+  ~APMPshm();
+
+  bool		isOpen() const			{ return _hdr != 0; }
+
+  /**
+   * Append one packet worth of decoded words to the ring.
+   */
+  void		publish(const ArincWords &words);
+
+  /**
+   * The CVT in the segment; hand it to APMPreader::setCVT().
+   */
+  ArincCVT *	cvt()				{ return _cvt; }
+
+  static std::string	segmentName(int port);
+
+private:
+  std::string	_name;
+  size_t	_size;
+  APMPshmHeader	*_hdr;
+  APMPshmWord	*_ring;
+  uint64_t	_mask;
+  ArincCVT	*_cvt;
+};
+
+
+/**
+ * Reader side.  Words are read in place, no copy:
+ *
+ *   const APMPshmWord *w;
+ *   int n = r.peek(w);
+ *   ... use w[0] to w[n-1] ...
+ *   int bad = r.release(n);	// first bad of those were overwritten
+ *				// while being read; throw them away.
+ */
+class APMPshmReader
+{
+public:
+  APMPshmReader();
+  ~APMPshmReader();
+
+  /**
+   * Map /apmp.<port> read only.  Cursor starts at the newest word.
+   */
+  bool		attach(int port);
+
+  /**
+   * Words ready at the cursor, contiguous in the ring.
+   */
+  int		peek(const APMPshmWord *&p);
+
+  /**
+   * Advance the cursor over n words from peek().
+   * @returns how many of the first of them may have been overwritten
+   * while the caller was reading them.
+   */
+  int		release(int n);
+
+  const APMPshmHeader &	header() const		{ return *_hdr; }
+  const ArincCVT &	cvt() const		{ return *_cvt; }
+
+  uint64_t	missed() const			{ return _missed; }
+
+private:
+  size_t	_size;
+  const APMPshmHeader *_hdr;
+  const APMPshmWord *_ring;
+  const ArincCVT *_cvt;
+  uint64_t	_mask;
+  uint64_t	_cursor;
+  uint64_t	_missed;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _apmp_stats_h_
+#define _apmp_stats_h_
+
+#include <stdint.h>
+
+#include <atomic>
+
+// RXP control word channel field is 4 bits; the Alta only uses 0-7.
+static const int APMP_MAX_CHANNELS = 16;
+
+typedef std::atomic<uint64_t> APMPcounter;
+
+/**
+ * Single writer increment.  Plain load/store, no locked instruction; the
+ * atomic type is only there so readers on other threads never see a torn
+ * value.
+ */
+inline void bump(APMPcounter &c, uint64_t n = 1)
+{
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ * Live counters, owned and written by the decode thread.  Each channel
+ * gets its own cache line so a reporting thread reading one channel does
+ * not bounce the line the decoder is writing for another.
+ */
+struct alignas(64) APMPchannelCounters
+{
+  APMPcounter	numRXP, decodeError, seqError;
+};
+
+struct APMPcounters
+{
+  alignas(64) APMPcounter numAPMPpackets, modeError, statusError, magicCookieError, APMPseqError;
+  APMPchannelCounters channel[APMP_MAX_CHANNELS];
+};
+
+/**
+ * Plain copy of the counters, see APMPreader::snapshot().
+ */
+struct APMPstats
+{
+  uint64_t	numAPMPpackets, modeError, statusError, magicCookieError, APMPseqError;
+  struct
+  {
+    uint64_t	numRXP, decodeError, seqError;
+  } channel[APMP_MAX_CHANNELS];
+};
+
+#endif
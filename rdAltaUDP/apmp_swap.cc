@@ -0,0 +1,94 @@
+#include "apmp_swap.h"
+
+#include <netinet/in.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+typedef void (*swap_fn)(uint32_t *, size_t);
+
+
+/* -------------------------------------------------------------------- */
+void swapWords_scalar(uint32_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    p[i] = ntohl(p[i]);
+}
+
+#ifdef HAVE_X86_KERNELS
+/* -------------------------------------------------------------------- */
+__attribute__((target("ssse3")))
+void swapWords_ssse3(uint32_t *p, size_t n)
+{
+  const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)&p[i]);
+    _mm_storeu_si128((__m128i *)&p[i], _mm_shuffle_epi8(v, mask));
+  }
+
+  swapWords_scalar(&p[i], n - i);
+}
+
+/* -------------------------------------------------------------------- */
+__attribute__((target("avx2")))
+void swapWords_avx2(uint32_t *p, size_t n)
+{
+  const __m256i mask = _mm256_set_epi8(
+	12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+	12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&p[i]);
+    _mm256_storeu_si256((__m256i *)&p[i], _mm256_shuffle_epi8(v, mask));
+  }
+
+  // Tail stays in this function, calling the non-VEX SSSE3 kernel from
+  // here costs an AVX/SSE transition.
+  for (; i < n; ++i)
+    p[i] = __builtin_bswap32(p[i]);
+}
+#else
+void swapWords_ssse3(uint32_t *p, size_t n)	{ swapWords_scalar(p, n); }
+void swapWords_avx2(uint32_t *p, size_t n)	{ swapWords_scalar(p, n); }
+#endif
+
+/* -------------------------------------------------------------------- */
+static const char *swapKernelName = "scalar";
+
+static swap_fn selectKernel()
+{
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    swapKernelName = "avx2";
+    return swapWords_avx2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    swapKernelName = "ssse3";
+    return swapWords_ssse3;
+  }
+#endif
+  return swapWords_scalar;
+}
+
+// Chosen once at load time, before any reader thread exists.
+static const swap_fn swapKernel = selectKernel();
+
+/* -------------------------------------------------------------------- */
+void swapWords(uint32_t *p, size_t n)
+{
+  swapKernel(p, n);
+}
+
+/* -------------------------------------------------------------------- */
+const char *swapWordsKernel()
+{
+  return swapKernelName;
+}
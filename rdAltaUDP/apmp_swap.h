@@ -0,0 +1,24 @@
+#ifndef _apmp_swap_h_
+#define _apmp_swap_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Big endian to host swap of n 32-bit words, in place.  The AVX2, SSSE3
+ * or scalar kernel is picked once, during static initialization, based
+ * on what the CPU supports.
+ */
+void swapWords(uint32_t *p, size_t n);
+
+// Individual kernels, exposed for the benchmark.
+void swapWords_scalar(uint32_t *p, size_t n);
+void swapWords_ssse3(uint32_t *p, size_t n);
+void swapWords_avx2(uint32_t *p, size_t n);
+
+/**
+ * Name of the kernel swapWords() dispatches to; "avx2", "ssse3" or "scalar".
+ */
+const char *swapWordsKernel();
+
+#endif
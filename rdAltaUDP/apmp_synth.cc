@@ -0,0 +1,111 @@
+#include <netinet/in.h>
+
+#include "apmp_synth.h"
+#include "arinc_decode.h"
+
+static inline uint32_t bcd(int x)	{ return ((x / 10) << 4) | (x % 10); }
+
+
+/* -------------------------------------------------------------------- */
+APMPsynth::APMPsynth(unsigned seed) : _rng(seed * 0x9E3779B97F4A7C15ULL + 1), _nChannels(8),
+	_nRXP(APMP_MAX_RXP), _nLabels(32), _errorRate(0.0), _seqGapRate(0.0),
+	_seqNum(1), _prevPE(0), _numRXP(0), _numErrors(0), _numSeqGaps(0)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    _channels[i] = i;
+    _rxpSeqNum[i] = 0;
+    _labelIndex[i] = 0;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void APMPsynth::setChannels(const int *channels, int n)
+{
+  _nChannels = 0;
+  for (int i = 0; i < n && _nChannels < (int)(sizeof(_channels) / sizeof(_channels[0])); ++i)
+    if (channels[i] >= 0 && channels[i] < 8)
+      _channels[_nChannels++] = channels[i];
+
+  if (_nChannels == 0)
+    _channels[_nChannels++] = 0;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPsynth::setRXPs(int n)
+{
+  _nRXP = n < 1 ? 1 : n > APMP_MAX_RXP ? APMP_MAX_RXP : n;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPsynth::setLabels(int n)
+{
+  _nLabels = n < 1 ? 1 : n > 256 ? 256 : n;
+}
+
+/* -------------------------------------------------------------------- */
+unsigned APMPsynth::random()
+{
+  // xorshift64*; rand() is not reentrant, and this is reproducible
+  // across libcs for a given seed.
+  _rng ^= _rng >> 12;
+  _rng ^= _rng << 25;
+  _rng ^= _rng >> 27;
+  return (_rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+/* -------------------------------------------------------------------- */
+int APMPsynth::build(char *buffer, long long peTicks, const struct timespec &utc)
+{
+  uint32_t *hdr = (uint32_t *)buffer;
+  rxp *p = (rxp *)(buffer + sizeof(APMP_hdr));
+  struct tm gm;
+
+  gmtime_r(&utc.tv_sec, &gm);
+
+  if (_prevPE == 0 || _prevPE > peTicks)
+    _prevPE = peTicks;
+
+  for (int i = 0; i < _nRXP; ++i)
+  {
+    int channel = _channels[random() % _nChannels];
+    uint32_t control = ((uint32_t)channel << 24) | ((uint32_t)_rxpSeqNum[channel] << 16);
+
+    if (chance(_errorRate)) {
+      control |= 0x80000000;
+      ++_numErrors;
+    }
+    ++_rxpSeqNum[channel];
+    if (chance(_seqGapRate)) {
+      ++_rxpSeqNum[channel];
+      ++_numSeqGaps;
+    }
+
+    // Labels are cycled per channel; 37 is coprime to 256 so they are
+    // distinct.  The label goes out bit reversed.
+    int label = (_labelIndex[channel]++ % _nLabels) * 37 % 256;
+    uint32_t data = (random() & 0xFFFFFF00) | labelReverse[label];
+
+    long long ticks = _prevPE + (peTicks - _prevPE) * (i + 1) / _nRXP;
+
+    p[i].control = htonl(control);
+    p[i].timeHigh = htonl(ticks >> 32);
+    p[i].timeLow = htonl(ticks & 0xFFFFFFFF);
+    p[i].data = htonl(data);
+  }
+  _numRXP += _nRXP;
+
+  hdr[0] = htonl(1);			// mode
+  hdr[1] = htonl(_seqNum++);
+  hdr[2] = 0;				// status
+  hdr[3] = htonl(0x414C5441);		// "ALTA"
+  hdr[4] = hdr[5] = hdr[6] = 0;
+  hdr[7] = htonl(16 + _nRXP * sizeof(rxp));
+  hdr[8] = htonl(peTicks >> 32);
+  hdr[9] = htonl(peTicks & 0xFFFFFFFF);
+  hdr[10] = htonl((bcd((gm.tm_yday + 1) / 100) << 8) | bcd((gm.tm_yday + 1) % 100));
+  hdr[11] = htonl((bcd(gm.tm_hour) << 16) | (bcd(gm.tm_min) << 8) | bcd(gm.tm_sec));
+
+  _prevPE = peTicks;
+  return sizeof(APMP_hdr) + _nRXP * sizeof(rxp);
+}
@@ -0,0 +1,91 @@
+#ifndef _apmp_synth_h_
+#define _apmp_synth_h_
+
+#include <time.h>
+
+#include "AltaEnet.h"
+
+/**
+ * Builds synthetic APMP datagrams, big endian as the Alta sends them, that
+ * APMPreader accepts: mode 1, "ALTA" magic, incrementing seqNum, PE and
+ * IRIG times, and RXPs carrying a per-channel 8 bit sequence counter.
+ *
+ * Faults can be injected at the RXP level: error bits, and skipped per
+ * channel sequence numbers.  Whole datagram loss and reordering are up to
+ * whoever sends the datagrams (see apmp_gen.cc).
+ */
+class APMPsynth
+{
+public:
+  APMPsynth(unsigned seed = 1);
+
+  /**
+   * Channels to put RXPs on, picked at random per RXP.  Repeat a channel
+   * to weight it, e.g. {0,0,0,1}.  Default is all eight, evenly.
+   */
+  void		setChannels(const int *channels, int n);
+
+  /**
+   * RXPs per datagram, 1 to APMP_MAX_RXP.  Default is APMP_MAX_RXP.
+   */
+  void		setRXPs(int n);
+
+  /**
+   * Distinct labels cycled through on each channel.  Default 32.
+   */
+  void		setLabels(int n);
+
+  /**
+   * Fraction of RXPs with the control word error bit set.
+   */
+  void		setErrorRate(double f)		{ _errorRate = f; }
+
+  /**
+   * Fraction of RXPs after which the channel sequence counter skips one,
+   * as if the Alta had lost a word.
+   */
+  void		setSeqGapRate(double f)		{ _seqGapRate = f; }
+
+  /**
+   * Next datagram.  RXP time tags are spread evenly between the previous
+   * datagram's PE time and this one.
+   * @param peTicks PE time of this datagram, 20ns ticks.
+   * @param utc IRIG time to put in the header.
+   * @param buffer at least APMP_MAX_PACKET bytes.
+   * @returns datagram length in bytes.
+   */
+  int		build(char *buffer, long long peTicks, const struct timespec &utc);
+
+  /**
+   * seqNum the next datagram will carry.
+   */
+  uint32_t	seqNum() const			{ return _seqNum; }
+
+  long long	numRXP() const			{ return _numRXP; }
+  long long	numErrors() const		{ return _numErrors; }
+  long long	numSeqGaps() const		{ return _numSeqGaps; }
+
+private:
+  unsigned	random();
+  bool		chance(double f)	{ return f > 0.0 && random() < f * 4294967296.0; }
+
+  uint64_t	_rng;
+
+  int		_channels[64];
+  int		_nChannels;
+  int		_nRXP;
+  int		_nLabels;
+  double	_errorRate;
+  double	_seqGapRate;
+
+  uint32_t	_seqNum;
+  long long	_prevPE;
+  uint8_t	_rxpSeqNum[8];
+  uint8_t	_labelIndex[8];
+
+  long long	_numRXP;
+  long long	_numErrors;
+  long long	_numSeqGaps;
+};
+
+#endif
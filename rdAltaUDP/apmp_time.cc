@@ -0,0 +1,222 @@
+#include <cstdio>
+#include <cstring>
+
+#include "apmp_time.h"
+
+static const long long NS_PER_SEC = 1000000000LL;
+static const long long NS_PER_TICK = 20;		// 50MHz PE clock
+
+/**
+ * BCD to binary, -1 if any nibble is over 9.
+ */
+static int bcd(uint32_t x)
+{
+  int v = 0, scale = 1;
+
+  for (; x; x >>= 4, scale *= 10)
+  {
+    if ((x & 0xF) > 9)
+      return -1;
+    v += (x & 0xF) * scale;
+  }
+  return v;
+}
+
+
+/* -------------------------------------------------------------------- */
+APMPtime::APMPtime() : _prevPE(0), _prevIrigHigh(0), _prevIrigLow(0), _prevSecNs(-1),
+	_secStartPE(0), _irigLosses(0), _resets(0), _numAnchors(0)
+{
+  reset();
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::reset()
+{
+  _state = UNLOCKED;
+  _nAnchors = 0;
+  _next = 0;
+  _basePE = _baseNs = _offsetNs = _slopeQ32 = 0;
+  _residualMaxNs = 0;
+}
+
+/* -------------------------------------------------------------------- */
+long long APMPtime::irigToUTC(uint32_t irigHigh, uint32_t irigLow, const struct timespec &host)
+{
+  int day = bcd(irigHigh & 0xFFF);
+  int hour = bcd((irigLow >> 16) & 0xFF);
+  int min = bcd((irigLow >> 8) & 0xFF);
+  int sec = bcd(irigLow & 0xFF);
+
+  if (day < 1 || day > 366 || hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 60)
+    return -1;
+
+  // No year in the header; use the one that puts us nearest the host clock.
+  struct tm gm;
+  gmtime_r(&host.tv_sec, &gm);
+
+  long long best = -1, bestDiff = 0;
+  for (int year = gm.tm_year - 1; year <= gm.tm_year + 1; ++year)
+  {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_year = year;
+    t.tm_mday = day;		// timegm() normalizes day of year into the months.
+    t.tm_hour = hour;
+    t.tm_min = min;
+    t.tm_sec = sec;
+
+    long long s = timegm(&t);
+    long long diff = s > host.tv_sec ? s - host.tv_sec : host.tv_sec - s;
+    if (best < 0 || diff < bestDiff) {
+      best = s;
+      bestDiff = diff;
+    }
+  }
+  return best * NS_PER_SEC;
+}
+
+/* -------------------------------------------------------------------- */
+APMPtime::State APMPtime::update(long long pe, uint32_t irigHigh, uint32_t irigLow, const struct timespec &host)
+{
+  if (pe < _prevPE) {
+    reset();
+    ++_resets;
+    _prevSecNs = -1;
+  }
+
+  long long secNs = _prevSecNs;
+  if (_prevPE == 0 || irigHigh != _prevIrigHigh || irigLow != _prevIrigLow)
+    secNs = irigToUTC(irigHigh, irigLow, host);
+
+  bool lost = (secNs < 0);
+
+  if (!lost && secNs != _prevSecNs)
+  {
+    // IRIG ticked over between the last packet and this one.  A jump of
+    // more than one second is lost packets or a step; no anchor, and a
+    // step is caught by the next anchor.
+    if (_prevSecNs >= 0 && secNs == _prevSecNs + NS_PER_SEC && pe - _prevPE <= MAX_BRACKET_TICKS)
+      addAnchor(_prevPE + (pe - _prevPE) / 2, secNs);
+    _secStartPE = pe;
+  }
+  else
+  if (!lost && pe - _secStartPE > STUCK_TICKS)
+    lost = true;
+
+  if (lost && _state == LOCKED) {
+    _state = HOLDOVER;
+    ++_irigLosses;
+  }
+
+  _prevPE = pe;
+  _prevIrigHigh = irigHigh;
+  _prevIrigLow = irigLow;
+  _prevSecNs = secNs;
+  return _state;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::addAnchor(long long pe, long long ns)
+{
+  if (_nAnchors > 0)
+  {
+    long long err = ns - toUTC(pe);
+    if (err > STEP_NS || err < -STEP_NS) {
+      reset();
+      ++_resets;
+    }
+  }
+
+  _anchors[_next].pe = pe;
+  _anchors[_next].ns = ns;
+  _next = (_next + 1) % MAX_ANCHORS;
+  if (_nAnchors < MAX_ANCHORS)
+    ++_nAnchors;
+  ++_numAnchors;
+
+  fit();
+  _state = LOCKED;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::fit()
+{
+  // Fit the residual from the nominal 20ns/tick, relative to the newest
+  // anchor, so the sums stay well inside 128 bits.
+  const Anchor &base = _anchors[(_next + MAX_ANCHORS - 1) % MAX_ANCHORS];
+  __int128 sx = 0, sy = 0, sxx = 0, sxy = 0;
+  int n = _nAnchors;
+
+  for (int i = 0; i < n; ++i)
+  {
+    long long dx = _anchors[i].pe - base.pe;
+    long long dy = _anchors[i].ns - base.ns - NS_PER_TICK * dx;
+    sx += dx;
+    sy += dy;
+    sxx += (__int128)dx * dx;
+    sxy += (__int128)dx * dy;
+  }
+
+  __int128 den = n * sxx - sx * sx;
+  __int128 slope = den != 0 ? ((n * sxy - sx * sy) << 32) / den : 0;
+
+  _basePE = base.pe;
+  _baseNs = base.ns;
+  _slopeQ32 = slope;
+  _offsetNs = (sy - ((slope * sx) >> 32)) / n;
+
+  _residualMaxNs = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    long long r = _anchors[i].ns - toUTC(_anchors[i].pe);
+    if (r < 0) r = -r;
+    if (r > _residualMaxNs)
+      _residualMaxNs = r;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+long long APMPtime::toUTC(long long pe) const
+{
+  if (_nAnchors == 0)
+    return 0;
+
+  long long dx = pe - _basePE;
+  return _baseNs + NS_PER_TICK * dx + _offsetNs + (long long)(((__int128)dx * _slopeQ32) >> 32);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::convert(ArincWords &w) const
+{
+  for (int i = 0; i < w.n; ++i)
+    w.utc[i] = toUTC(w.ticks[i]);
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::merge(const APMPtime &later)
+{
+  // The fit is the latest one; counts add up.
+  int irigLosses = _irigLosses + later._irigLosses;
+  int resets = _resets + later._resets;
+  uint64_t numAnchors = _numAnchors + later._numAnchors;
+
+  *this = later;
+  _irigLosses = irigLosses;
+  _resets = resets;
+  _numAnchors = numAnchors;
+}
+
+/* -------------------------------------------------------------------- */
+void APMPtime::print() const
+{
+  static const char *states[] = { "unlocked", "locked", "holdover" };
+
+  if (_numAnchors == 0 && _irigLosses == 0)
+    return;
+
+  printf("\n\nPE clock to UTC, %s, %llu IRIG second anchors, fit over last %d\n",
+	states[_state], (unsigned long long)_numAnchors, _nAnchors);
+  printf("  PE clock rate error=%+.3f ppm, fit residual max=%.1f usec, IRIG losses=%d, resets=%d\n",
+	_slopeQ32 / 4294967296.0 / NS_PER_TICK * 1.0e6, _residualMaxNs / 1000.0, _irigLosses, _resets);
+}
@@ -0,0 +1,98 @@
+#ifndef _apmp_time_h_
+#define _apmp_time_h_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "arinc_decode.h"
+
+/**
+ * PE clock to UTC for one Alta unit, so every RXP gets an absolute time.
+ *
+ * The header IRIG time is whole seconds only.  Where it ticks over from one
+ * packet to the next, the second boundary fell between the two PE times;
+ * the midpoint is an anchor (PE ticks, UTC ns).  A least squares line
+ * through the last 16 anchors maps any PE time tag to UTC, following the
+ * drift of the PE oscillator.  All integer math; UTC is ns since the epoch.
+ *
+ * The IRIG header has no year; it is taken from the host receive time.
+ * Day and year rollover fall out of that.  The PE clock going backwards
+ * (unit reset, counter wrap) or IRIG disagreeing with the fit by more than
+ * STEP_NS starts over.  While IRIG is missing, stuck or not valid BCD the
+ * last fit is extrapolated (HOLDOVER).
+ */
+class APMPtime
+{
+public:
+  enum State { UNLOCKED, LOCKED, HOLDOVER };
+
+  APMPtime();
+
+  /**
+   * Feed the time fields of one packet header, host byte order.
+   * @param host receive time, only used to pick the year.
+   */
+  State		update(long long peTicks, uint32_t irigHigh, uint32_t irigLow, const struct timespec &host);
+
+  /**
+   * @returns UTC, ns since the epoch, of a PE time tag; 0 while UNLOCKED.
+   */
+  long long	toUTC(long long peTicks) const;
+
+  /**
+   * Fill in w.utc from w.ticks.
+   */
+  void		convert(ArincWords &w) const;
+
+  State		state() const			{ return _state; }
+
+  void		print() const;
+
+  /**
+   * Add the counts from a run over a later part of the same stream.
+   */
+  void		merge(const APMPtime &later);
+
+  static const int MAX_ANCHORS = 16;
+
+  // Farthest apart two packets may be and still bracket a second boundary.
+  static const long long MAX_BRACKET_TICKS = 2500000;	// 50ms
+
+  // Anchor this far off the fit; IRIG was stepped.
+  static const long long STEP_NS = 100000000;		// 100ms
+
+  // Same IRIG second for this long; IRIG is stuck.
+  static const long long STUCK_TICKS = 75000000;		// 1.5s
+
+private:
+  struct Anchor
+  {
+    long long	pe;	// PE ticks
+    long long	ns;	// UTC ns since the epoch
+  };
+
+  void		reset();
+  void		addAnchor(long long pe, long long ns);
+  void		fit();
+  long long	irigToUTC(uint32_t irigHigh, uint32_t irigLow, const struct timespec &host);
+
+  State		_state;
+
+  Anchor	_anchors[MAX_ANCHORS];
+  int		_nAnchors, _next;
+
+  // utc = _baseNs + 20 * dx + _offsetNs + (dx * _slopeQ32 >> 32), dx = pe - _basePE
+  long long	_basePE, _baseNs, _offsetNs, _slopeQ32;
+  long long	_residualMaxNs;
+
+  // Last packet.
+  long long	_prevPE;
+  uint32_t	_prevIrigHigh, _prevIrigLow;
+  long long	_prevSecNs;		// its IRIG second as UTC ns, -1 if invalid
+  long long	_secStartPE;		// first PE seen with that IRIG second
+
+  int		_irigLosses, _resets;
+  uint64_t	_numAnchors;
+};
+
+#endif
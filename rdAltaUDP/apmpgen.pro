@@ -0,0 +1,14 @@
+######################################################################
+# Synthetic APMP traffic generator.  qmake apmpgen.pro; make -f Makefile.apmpgen
+######################################################################
+
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= qt
+TARGET = apmpgen
+MAKEFILE = Makefile.apmpgen
+INCLUDEPATH += .
+
+# Input
+HEADERS += AltaEnet.h apmp_synth.h arinc_decode.h
+SOURCES += apmp_gen.cc apmp_synth.cc
@@ -0,0 +1,32 @@
+#include "arinc_decode.h"
+
+/* -------------------------------------------------------------------- */
+int decodeRXPs(const rxp *p, int n, ArincWords &out)
+{
+  if (n > APMP_MAX_RXP)
+    n = APMP_MAX_RXP;
+  if (n < 0)
+    n = 0;
+
+  for (int i = 0; i < n; ++i)
+  {
+    uint32_t control = p[i].control;
+    uint32_t data = p[i].data;
+
+    out.channel[i]	= (control & 0x0F000000) >> 24;
+    out.seqNum[i]	= (control & 0x00FF0000) >> 16;
+    out.error[i]	= control >> 31;
+    out.label[i]	= labelReverse[data & 0xFF];
+    out.sdi[i]		= (data >> 8) & 0x03;
+    out.data[i]		= (data >> 10) & 0x7FFFF;
+    out.ssm[i]		= (data >> 29) & 0x03;
+    out.parity[i]	= data >> 31;
+    out.raw[i]		= (data & 0xFFFFFF00) >> 8;
+    out.word[i]		= data;
+    out.ticks[i]	= ((long long)p[i].timeHigh << 32) | p[i].timeLow;
+    out.def[i]		= 0;
+  }
+
+  out.n = n;
+  return n;
+}
@@ -0,0 +1,54 @@
+#ifndef _arinc_decode_h_
+#define _arinc_decode_h_
+
+#include "AltaEnet.h"
+
+/**
+ * ARINC 429 label bit reversal.  The label goes out MSB first, so the Alta
+ * hands us bits 1-8 of the word reversed.
+ */
+#define R2(n)	n, n + 2*64, n + 1*64, n + 3*64
+#define R4(n)	R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#define R6(n)	R4(n), R4(n + 2*4), R4(n + 1*4), R4(n + 3*4)
+static constexpr uint8_t labelReverse[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R2
+#undef R4
+#undef R6
+
+static_assert(labelReverse[0x13] == 0310, "label bit reversal table");
+
+inline uint32_t decodeLabel(uint32_t data)	{ return labelReverse[data & 0xFF]; }
+
+
+/**
+ * One packet worth of RXPs, decoded once into a struct-of-arrays so the
+ * printer, statistics and other consumers can each walk just the fields
+ * they need.
+ */
+struct ArincWords
+{
+  int		n;
+
+  uint8_t	channel[APMP_MAX_RXP];	// control bits 24-27; 0-7 valid.
+  uint8_t	seqNum[APMP_MAX_RXP];	// control bits 16-23, per channel counter.
+  uint8_t	error[APMP_MAX_RXP];	// control bit 31.
+  uint8_t	label[APMP_MAX_RXP];	// bit reversed, print with %04o
+  uint8_t	sdi[APMP_MAX_RXP];	// ARINC bits 9-10
+  uint8_t	ssm[APMP_MAX_RXP];	// ARINC bits 30-31
+  uint8_t	parity[APMP_MAX_RXP];	// ARINC bit 32
+  uint32_t	data[APMP_MAX_RXP];	// ARINC bits 11-29
+  uint32_t	raw[APMP_MAX_RXP];	// ARINC bits 9-32, what rdudp prints.
+  uint32_t	word[APMP_MAX_RXP];	// Whole ARINC word, as received.
+  long long	ticks[APMP_MAX_RXP];	// PE time tag, 20ns ticks.
+  long long	utc[APMP_MAX_RXP];	// ticks as UTC ns, see APMPtime; 0 unlocked.
+  uint16_t	def[APMP_MAX_RXP];	// ArincEU definition, 0 is none.
+  double	value[APMP_MAX_RXP];	// engineering units, when def != 0.
+};
+
+/**
+ * Decode n host order RXPs into out.  n is clamped to APMP_MAX_RXP.
+ * @returns number of words decoded.
+ */
+int decodeRXPs(const rxp *p, int n, ArincWords &out);
+
+#endif
@@ -0,0 +1,133 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "arinc_eu.h"
+
+
+/* -------------------------------------------------------------------- */
+ArincEU::ArincEU() : _defs(1), _conv(1)
+{
+  memset(&_defs[0], 0, sizeof(Def));
+  memset(&_conv[0], 0, sizeof(Conv));
+  memset(_index, 0, sizeof(_index));
+}
+
+/* -------------------------------------------------------------------- */
+bool ArincEU::add(const Def &def)
+{
+  if (def.channel < -1 || def.channel > 7 || def.label < 0 || def.label > 0377 ||
+      def.sdi < -1 || def.sdi > 3 || def.lsb < 9 || def.msb > 29 || def.msb < def.lsb ||
+      def.encoding == NONE || _defs.size() >= 65535)
+    return false;
+
+  // SDI bits 9-10 are data for this label; it has no SDI.
+  if (def.lsb < 11 && def.sdi != -1)
+    return false;
+
+  // BNR sign is bit 29 itself.
+  if (def.encoding == BNR && def.sign && def.msb > 28)
+    return false;
+
+  Conv c;
+  int width = def.msb - def.lsb + 1;
+
+  c.encoding = def.encoding;
+  c.shift = def.lsb - 1;
+  c.digits = (width + 3) / 4;
+  c.sign = def.sign;
+  c.mask = width >= 32 ? 0xFFFFFFFF : (1U << width) - 1;
+  c.scale = def.resolution;
+  // Sign in bit 29, the field sign extended up to it.
+  c.signValue = -ldexp(def.resolution, width);
+
+  int n = _defs.size();
+  _defs.push_back(def);
+  _conv.push_back(c);
+
+  for (int ch = 0; ch < 8; ++ch)
+    for (int sdi = 0; sdi < 4; ++sdi)
+      if ((def.channel == -1 || def.channel == ch) && (def.sdi == -1 || def.sdi == sdi))
+        _index[(ch * 256 + def.label) * 4 + sdi] = n;
+
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+bool ArincEU::load(const char *fileName)
+{
+  FILE *fp = fopen(fileName, "r");
+  char line[256];
+  int lineNum = 0;
+  bool ok = true;
+
+  if (fp == 0) {
+    perror(fileName);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    char ch[8], sdi[8], enc[8], sign[8];
+    Def def;
+
+    ++lineNum;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0')
+      continue;
+
+    memset(&def, 0, sizeof(def));
+    int n = sscanf(p, "%7s %o %7s %7s %d %d %lf %7s %23s %15s", ch, &def.label, sdi, enc,
+		&def.msb, &def.lsb, &def.resolution, sign, def.name, def.units);
+
+    def.channel = strcmp(ch, "*") ? atoi(ch) : -1;
+    def.sdi = strcmp(sdi, "*") ? atoi(sdi) : -1;
+    def.encoding = !strcmp(enc, "BNR") ? BNR : !strcmp(enc, "BCD") ? BCD : !strcmp(enc, "DIS") ? DISCRETE : NONE;
+    def.sign = (n >= 8 && sign[0] == '1');
+
+    if (n < 9 || !add(def)) {
+      fprintf(stderr, "ArincEU: %s:%d: bad definition: %s", fileName, lineNum, line);
+      ok = false;
+    }
+  }
+
+  fclose(fp);
+  return ok;
+}
+
+/* -------------------------------------------------------------------- */
+void ArincEU::convert(ArincWords &w) const
+{
+  for (int i = 0; i < w.n; ++i)
+  {
+    int d = w.channel[i] < 8 ? _index[(w.channel[i] * 256 + w.label[i]) * 4 + w.sdi[i]] : 0;
+    const Conv &c = _conv[d];
+    uint32_t word = w.word[i];
+    uint32_t field = (word >> c.shift) & c.mask;
+
+    w.def[i] = d;
+    switch (c.encoding)
+    {
+      case BNR:
+        w.value[i] = field * c.scale + (c.sign && (word & 0x10000000) ? c.signValue : 0.0);
+        break;
+
+      case BCD:
+      {
+        uint32_t v = 0;
+        for (int k = c.digits - 1; k >= 0; --k)
+          v = v * 10 + ((field >> (4 * k)) & 0xF);
+        w.value[i] = (c.sign && w.ssm[i] == 3) ? -(v * c.scale) : v * c.scale;
+        break;
+      }
+
+      case DISCRETE:
+        w.value[i] = field * c.scale;
+        break;
+
+      default:
+        w.value[i] = 0.0;
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef _arinc_eu_h_
+#define _arinc_eu_h_
+
+#include <stdint.h>
+#include <vector>
+
+#include "arinc_decode.h"
+
+/**
+ * ARINC 429 engineering unit conversion.
+ *
+ * Label definitions (channel, label, SDI, encoding, bit range, resolution,
+ * sign) are loaded once, see doc/arinc_labels.conf, and compiled into a
+ * dense [channel][label][sdi] array of small conversion records, so each
+ * RXP is one table lookup and a switch on the encoding in the decode loop.
+ *
+ * Bits are numbered as in the ARINC spec, 1-32, label in 1-8.
+ *  BNR	two's complement, sign in bit 29 when signed; value = field * resolution.
+ *  BCD	4 bit digits down from msb, the top one may be short; SSM 11 is
+ *	minus when signed; value = digits * resolution.
+ *  DIS	unsigned bit field * resolution.
+ */
+class ArincEU
+{
+public:
+  enum Encoding { NONE, BNR, BCD, DISCRETE };
+
+  struct Def
+  {
+    int		channel;	// -1 is any
+    int		label;		// as printed, 0310 etc.
+    int		sdi;		// -1 is any
+    Encoding	encoding;
+    int		msb, lsb;	// ARINC bit numbers
+    double	resolution;	// units per lsb
+    bool	sign;
+    char	name[24];
+    char	units[16];
+  };
+
+  ArincEU();
+
+  /**
+   * Read definitions from a file, one per line:
+   *   channel label sdi encoding msb lsb resolution signed name [units]
+   * channel and sdi may be '*'; label is octal.  Later lines override
+   * earlier ones for the same channel/label/sdi.
+   * @returns false, after saying why on stderr, on any bad line.
+   */
+  bool		load(const char *fileName);
+
+  /**
+   * @returns false if the definition is out of range.
+   */
+  bool		add(const Def &def);
+
+  /**
+   * Fill in w.value and w.def for every word with a definition.
+   */
+  void		convert(ArincWords &w) const;
+
+  /**
+   * @param i from ArincWords::def; 1 to size().
+   */
+  const Def &	def(int i) const		{ return _defs[i]; }
+  int		size() const			{ return _defs.size() - 1; }
+
+private:
+  struct Conv
+  {
+    uint8_t	encoding;
+    uint8_t	shift;		// lsb - 1
+    uint8_t	digits;		// BCD
+    uint8_t	sign;
+    uint32_t	mask;		// field width
+    double	scale;
+    double	signValue;	// BNR: what a set sign bit is worth
+  };
+
+  std::vector<Def>	_defs;		// [0] unused, index 0 is no definition
+  std::vector<Conv>	_conv;		// parallel to _defs
+  uint16_t	_index[8 * 256 * 4];
+};
+
+#endif
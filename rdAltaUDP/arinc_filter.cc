@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+
+#include "arinc_filter.h"
+
+
+/* -------------------------------------------------------------------- */
+ArincFilter::ArincFilter()
+{
+  memset(_sdiMask, 0, sizeof(_sdiMask));
+  memset(_wanted, 0, sizeof(_wanted));
+}
+
+/* -------------------------------------------------------------------- */
+void ArincFilter::add(int channel, int label, unsigned sdiMask)
+{
+  if (channel < 0 || channel > 7 || label < 0 || label > 0377 || !(sdiMask & 0xF))
+    return;
+
+  int raw = labelReverse[label];	// reversal is its own inverse
+  _sdiMask[channel][raw] |= sdiMask & 0xF;
+  _wanted[channel] = true;
+}
+
+/* -------------------------------------------------------------------- */
+bool ArincFilter::parse(const char *spec)
+{
+  char *end;
+  int channel = strtol(spec, &end, 10);
+  int labels[256], nLabels = 0;
+  unsigned sdiMask = 0;
+
+  if (end == spec || *end != ':' || channel < 0 || channel > 7)
+    return false;
+
+  for (spec = end + 1; ; spec = end + 1)
+  {
+    if (*spec == '*') {
+      for (int l = 0; l < 256; ++l)
+        labels[l] = l;
+      nLabels = 256;
+      end = (char *)spec + 1;
+    }
+    else {
+      int label = strtol(spec, &end, 8);
+      if (end == spec || label > 0377 || nLabels >= 256)
+        return false;
+      labels[nLabels++] = label;
+    }
+    if (*end != ',')
+      break;
+  }
+
+  if (*end == ':')
+  {
+    for (spec = end + 1; ; spec = end + 1)
+    {
+      int sdi = strtol(spec, &end, 10);
+      if (end == spec || sdi < 0 || sdi > 3)
+        return false;
+      sdiMask |= 1 << sdi;
+      if (*end != ',')
+        break;
+    }
+  }
+  else
+    sdiMask = 0xF;
+
+  if (*end != '\0')
+    return false;
+
+  for (int i = 0; i < nLabels; ++i)
+    add(channel, labels[i], sdiMask);
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+int decodeRXPs(const rxp *p, int n, const ArincFilter &filter, ArincWords &all, ArincWords &kept)
+{
+  int a = 0, k = 0;
+
+  if (n > APMP_MAX_RXP)
+    n = APMP_MAX_RXP;
+  if (n < 0)
+    n = 0;
+
+  for (int i = 0; i < n; ++i)
+  {
+    uint32_t control = ntohl(p[i].control);
+    uint32_t channel = (control & 0x0F000000) >> 24;
+    if (!filter.wants(channel))
+      continue;
+
+    all.channel[a]	= channel;
+    all.seqNum[a]	= (control & 0x00FF0000) >> 16;
+    all.error[a]	= control >> 31;
+    ++a;
+
+    uint32_t data = ntohl(p[i].data);
+    if (!filter.pass(channel, data))
+      continue;
+
+    kept.channel[k]	= channel;
+    kept.seqNum[k]	= (control & 0x00FF0000) >> 16;
+    kept.error[k]	= control >> 31;
+    kept.label[k]	= labelReverse[data & 0xFF];
+    kept.sdi[k]		= (data >> 8) & 0x03;
+    kept.data[k]	= (data >> 10) & 0x7FFFF;
+    kept.ssm[k]		= (data >> 29) & 0x03;
+    kept.parity[k]	= data >> 31;
+    kept.raw[k]		= (data & 0xFFFFFF00) >> 8;
+    kept.word[k]	= data;
+    kept.ticks[k]	= ((long long)ntohl(p[i].timeHigh) << 32) | ntohl(p[i].timeLow);
+    kept.def[k]		= 0;
+    ++k;
+  }
+
+  all.n = a;
+  kept.n = k;
+  return k;
+}
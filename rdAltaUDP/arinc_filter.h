@@ -0,0 +1,64 @@
+#ifndef _arinc_filter_h_
+#define _arinc_filter_h_
+
+#include <stdint.h>
+
+#include "arinc_decode.h"
+
+/**
+ * Which RXPs to keep: an SDI mask per channel and label, 0 for a label
+ * not kept.
+ * Tested on the control and data words as they come off the wire, before
+ * anything else is decoded.  Nothing passes until something is added.
+ */
+class ArincFilter
+{
+public:
+  ArincFilter();
+
+  /**
+   * Keep label (as printed, 0310 etc.) on channel, for the SDIs in
+   * sdiMask, bit n for SDI n.
+   */
+  void		add(int channel, int label, unsigned sdiMask = 0xF);
+
+  /**
+   * Add "channel:label[,label...][:sdi[,sdi...]]", labels octal, e.g.
+   * "4:310,311" or "6:203:0,1".  A label of '*' is every label.  The SDI
+   * set belongs to the labels in the spec, not the channel: "4:310:0" and
+   * "4:311:1" keep 310 only on SDI 0 and 311 only on SDI 1.  A label given
+   * twice keeps the union of its SDI sets.
+   * @returns false on a bad spec.
+   */
+  bool		parse(const char *spec);
+
+  /**
+   * @returns true if any label on channel is kept.
+   */
+  bool		wants(uint32_t channel) const	{ return channel < 8 && _wanted[channel]; }
+
+  /**
+   * @param data ARINC word as received, label byte not yet reversed.
+   */
+  bool		pass(uint32_t channel, uint32_t data) const
+	{ return channel < 8 && (_sdiMask[channel][data & 0xFF] >> ((data >> 8) & 3) & 1); }
+
+private:
+  // Indexed by the label byte as received, so no bit reversal to test;
+  // bit n set keeps SDI n.
+  uint8_t	_sdiMask[8][256];
+  bool		_wanted[8];
+};
+
+/**
+ * decodeRXPs() for a filter: p is still big endian, straight off the
+ * wire.  RXPs on channels the filter has no labels for are dropped after
+ * the control word.  The rest have their control fields put in all
+ * (channel, seqNum, error), since the sequence checks need every word on
+ * a channel; only those that pass the filter get their data and time
+ * words swapped and decoded, into kept.
+ * @returns number of words kept.
+ */
+int decodeRXPs(const rxp *p, int n, const ArincFilter &filter, ArincWords &all, ArincWords &kept);
+
+#endif
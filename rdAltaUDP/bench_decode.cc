@@ -0,0 +1,189 @@
+/*
+ * APMP decode throughput benchmark.  Drives APMPreader::processPacket(),
+ * listing off, over in-memory corpora built by APMPsynth: the header
+ * checks, byte swap, per-RXP sequence checks, label decode and counters
+ * RdUDP::newData() does per datagram.
+ *
+ * Each datagram is first copied into a receive slot, as recvmmsg() would
+ * do, since processPacket() swaps in place.  The "copy ns/pkt" column
+ * times just that copy so it can be taken out.
+ *
+ * Same seed, same corpus; each figure is the best of -r runs, so results
+ * are comparable from one build to the next on the same machine.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <vector>
+
+#include "apmp_reader.h"
+#include "apmp_synth.h"
+
+static const ArincEU *eu = 0;
+static ArincFilter *filter = 0;
+
+struct Corpus
+{
+  const char	*name;
+  int		channels[8];
+  int		nChannels;
+  int		nRXP;
+  double	errorRate;
+};
+
+static const Corpus corpora[] =
+{
+  { "max size, 8 channels",	{ 0, 1, 2, 3, 4, 5, 6, 7 }, 8, APMP_MAX_RXP, 0.0 },
+  { "1 channel",		{ 0 }, 1, 16, 0.0 },
+  { "8 channels",		{ 0, 1, 2, 3, 4, 5, 6, 7 }, 8, 16, 0.0 },
+  { "error bits, 50%",		{ 0, 1, 2, 3, 4, 5, 6, 7 }, 8, APMP_MAX_RXP, 0.5 },
+};
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * nPackets datagrams of one corpus, SLOT_SIZE apart, with receive times.
+ */
+static void build(const Corpus &c, int nPackets, std::vector<char> &data,
+	std::vector<int> &lengths, std::vector<struct timespec> &times)
+{
+  APMPsynth synth(1);
+  synth.setChannels(c.channels, c.nChannels);
+  synth.setRXPs(c.nRXP);
+  synth.setErrorRate(c.errorRate);
+
+  data.assign((size_t)nPackets * SLOT_SIZE, 0);
+  lengths.resize(nPackets);
+  times.resize(nPackets);
+
+  // 1 ms apart, received 100 us after the PE time.
+  struct timespec utc = { 1700000000, 0 };
+  long long peTicks = 50000000;
+  for (int i = 0; i < nPackets; ++i, peTicks += 50000)
+  {
+    long long ns = peTicks * 20 + 100000;
+    times[i].tv_sec = utc.tv_sec + ns / 1000000000LL;
+    times[i].tv_nsec = ns % 1000000000LL;
+    lengths[i] = synth.build(&data[(size_t)i * SLOT_SIZE], peTicks, times[i]);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * One run over the corpus with a fresh reader, so the sequence checks
+ * never see the wrap back to the corpus start.
+ * @returns seconds.
+ */
+static double run(const std::vector<char> &data, const std::vector<int> &lengths,
+	const std::vector<struct timespec> &times, bool decode)
+{
+  APMPreader *reader = new APMPreader();
+  reader->setListing(false);
+  reader->setEU(eu);
+  reader->setFilter(filter);
+  static char slot[SLOT_SIZE];
+  int n = lengths.size();
+
+  double start = now();
+  for (int i = 0; i < n; ++i)
+  {
+    memcpy(slot, &data[(size_t)i * SLOT_SIZE], lengths[i]);
+    if (decode)
+      reader->processPacket(slot, lengths[i], times[i]);
+  }
+  double elapsed = now() - start;
+
+  APMPstats st;
+  reader->snapshot(st);
+  if (decode && st.numAPMPpackets != (uint64_t)n) {
+    fprintf(stderr, "bench_decode: reader accepted %llu of %d datagrams.\n",
+	(unsigned long long)st.numAPMPpackets, n);
+    exit(1);
+  }
+
+  delete reader;
+  return elapsed;
+}
+
+
+int main(int argc, char *argv[])
+{
+  int nPackets = 4096, nRuns = 5, nPasses = 50;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:p:r:e:f:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':		// Datagrams per corpus.
+        nPackets = atoi(optarg);
+        break;
+      case 'p':		// Passes over the corpus per run.
+        nPasses = atoi(optarg);
+        break;
+      case 'r':		// Runs; the best is reported.
+        nRuns = atoi(optarg);
+        break;
+      case 'e':		// Label definitions; time engineering unit conversion too.
+      {
+        ArincEU *table = new ArincEU();
+        if (!table->load(optarg))
+          exit(1);
+        eu = table;
+        break;
+      }
+      case 'f':		// channel:label[,label...][:sdi[,sdi...]]; time with an ingest filter.
+        if (!filter)
+          filter = new ArincFilter();
+        if (!filter->parse(optarg)) {
+          fprintf(stderr, "Bad filter '%s'\n", optarg);
+          exit(1);
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n datagrams] [-p passes] [-r runs] [-e label_file] [-f filter]...\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  std::vector<char> data;
+  std::vector<int> lengths;
+  std::vector<struct timespec> times;
+
+  printf("APMP decode, %d datagrams/corpus, %d passes, best of %d runs%s%s\n", nPackets, nPasses, nRuns,
+	eu ? ", with engineering units" : "", filter ? ", filtered" : "");
+  printf("  %-22s %11s %11s %10s %8s %11s\n", "corpus", "packets/s", "RXPs/s", "ns/packet", "ns/RXP", "copy ns/pkt");
+
+  for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); ++c)
+  {
+    double best[2] = { 1.0e30, 1.0e30 };	// copy only, decode
+
+    build(corpora[c], nPackets, data, lengths, times);
+
+    for (int decode = 0; decode < 2; ++decode)
+      for (int r = 0; r < nRuns; ++r)
+      {
+        double elapsed = 0.0;
+        for (int pass = 0; pass < nPasses; ++pass)
+          elapsed += run(data, lengths, times, decode);
+        if (elapsed < best[decode])
+          best[decode] = elapsed;
+      }
+
+    double nPkts = (double)nPackets * nPasses;
+    double nRXPs = nPkts * corpora[c].nRXP;
+    printf("  %-22s %11.0f %11.0f %10.1f %8.2f %11.1f\n", corpora[c].name,
+	nPkts / best[1], nRXPs / best[1], best[1] * 1.0e9 / nPkts, best[1] * 1.0e9 / nRXPs,
+	best[0] * 1.0e9 / nPkts);
+  }
+
+  return 0;
+}
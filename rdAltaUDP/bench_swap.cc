@@ -0,0 +1,112 @@
+/*
+ * Microbenchmark of the APMP byte swap kernels against the original
+ * per-word ntohl() loop, on maximum size (1376 byte payload) packets.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+
+#include "AltaEnet.h"
+#include "apmp_swap.h"
+
+static const int nPackets = 1024;	// working set of packets, ~1.4MB
+static const int nPasses = 2000;
+
+// Words per packet; 12 header words then (1376 - 16) / 16 RXPs of 4 words.
+static const size_t hdrWords = 12;
+static const size_t rxpWords = (APMP_MAX_PAYLOAD - 16) / sizeof(rxp) * 4;
+static const size_t pktWords = APMP_MAX_PACKET / sizeof(uint32_t);
+
+
+// The loop RdUDP::swapPacket() used.
+static void swapPacket_ntohl(uint32_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    p[i] = ntohl(p[i]);
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static void run(const char *name, void (*fn)(uint32_t *, size_t), uint32_t *packets)
+{
+  // Warm up.
+  for (int i = 0; i < nPackets; ++i)
+  {
+    fn(&packets[i * pktWords], hdrWords);
+    fn(&packets[i * pktWords + hdrWords], rxpWords);
+  }
+
+  double start = now();
+  for (int pass = 0; pass < nPasses; ++pass)
+    for (int i = 0; i < nPackets; ++i)
+    {
+      // Same two calls APMPreader::processPacket() makes.
+      fn(&packets[i * pktWords], hdrWords);
+      fn(&packets[i * pktWords + hdrWords], rxpWords);
+    }
+  double elapsed = now() - start;
+
+  double nPkts = (double)nPasses * nPackets;
+  printf("  %-8s %8.1f ns/packet  %7.2f GB/s\n", name,
+	elapsed * 1.0e9 / nPkts,
+	nPkts * (hdrWords + rxpWords) * sizeof(uint32_t) / elapsed / 1.0e9);
+}
+
+
+int main()
+{
+  uint32_t *packets = (uint32_t *)malloc(nPackets * pktWords * sizeof(uint32_t));
+  uint32_t *check = (uint32_t *)malloc(nPackets * pktWords * sizeof(uint32_t));
+
+  srand(1);
+  for (size_t i = 0; i < nPackets * pktWords; ++i)
+    packets[i] = rand();
+
+  // Every kernel must agree with ntohl() before we time anything.
+  // The SIMD kernels only exist on x86, see apmp_swap.cc.
+  void (*kernels[4])(uint32_t *, size_t) = { swapWords_scalar, swapWords };
+  const char *names[4] = { "scalar", "dispatch" };
+  int nKernels = 2;
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("ssse3")) {
+    kernels[nKernels] = swapWords_ssse3;
+    names[nKernels++] = "ssse3";
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[nKernels] = swapWords_avx2;
+    names[nKernels++] = "avx2";
+  }
+#endif
+  for (int k = 0; k < nKernels; ++k)
+  {
+    memcpy(check, packets, nPackets * pktWords * sizeof(uint32_t));
+    kernels[k](check, nPackets * pktWords);
+    for (size_t i = 0; i < nPackets * pktWords; ++i)
+      if (check[i] != ntohl(packets[i])) {
+        fprintf(stderr, "%s kernel mismatch at word %zu\n", names[k], i);
+        exit(1);
+      }
+  }
+
+  printf("APMP swap, %zu words/packet (%zu header + %zu RXP), dispatch=%s\n",
+	hdrWords + rxpWords, hdrWords, rxpWords, swapWordsKernel());
+
+  run("ntohl", swapPacket_ntohl, packets);
+  run("scalar", swapWords_scalar, packets);
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("ssse3")) run("ssse3", swapWords_ssse3, packets);
+  if (__builtin_cpu_supports("avx2")) run("avx2", swapWords_avx2, packets);
+#endif
+  run("dispatch", swapWords, packets);
+
+  free(packets);
+  free(check);
+  return 0;
+}
@@ -0,0 +1,14 @@
+######################################################################
+# APMP byte swap microbenchmark.  qmake bench_swap.pro; make -f Makefile.bench_swap
+######################################################################
+
+TEMPLATE = app
+CONFIG += console release
+CONFIG -= qt
+TARGET = bench_swap
+MAKEFILE = Makefile.bench_swap
+INCLUDEPATH += .
+
+# Input
+HEADERS += apmp_swap.h
+SOURCES += bench_swap.cc apmp_swap.cc
@@ -1,14 +1,29 @@
 #include <QApplication>
 
 #include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
 
 #include "rd_udp.h"
 
 RdUDP *rdr = 0;
+APMPrecorder *recorder = 0;
+ArincCVT *cvt = 0;
+APMPshm *shm = 0;
+APMPmetrics *metrics = 0;
 
 void sighandler(int s)
 {
+  delete metrics;		// stop reading rdr before it goes.
   delete rdr;
+  if (cvt)
+    cvt->print(stdout);
+  delete shm;
+  if (recorder) {
+    recorder->close();
+    recorder->printStatistics();
+  }
   exit(0);
 }
 
@@ -17,7 +32,101 @@ int main(int argc, char *argv[])
 {
   QApplication app(argc, argv, false);
 
-  rdr = new RdUDP();
+  bool batchMode = false, listing = true, direct = false, publish = false;
+  long long preallocate = 2048;		// MB
+  const char *captureFile = 0;
+  ArincEU *eu = 0;
+  ArincFilter *filter = 0;
+  int reportInterval = 10;		// seconds
+  int metricsPort = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "bw:a:Dqci:se:f:m:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b':		// Drain socket with recvmmsg() instead of one datagram per readyRead().
+        batchMode = true;
+        break;
+      case 'w':		// Record raw datagrams to this capture file.
+        captureFile = optarg;
+        break;
+      case 'a':		// MB of file space to preallocate for the capture.
+        preallocate = atoll(optarg);
+        break;
+      case 'D':		// Write the capture with O_DIRECT.
+        direct = true;
+        break;
+      case 'q':		// No listing on stdout, statistics only.
+        listing = false;
+        break;
+      case 'c':		// Keep a current value table, printed at exit.
+        cvt = new ArincCVT();
+        break;
+      case 'i':		// Seconds between loss reports, 0 reports every anomaly.
+        reportInterval = atoi(optarg);
+        break;
+      case 's':		// Publish decoded words and the CVT in shared memory.
+        publish = true;
+        break;
+      case 'e':		// Label definitions for engineering unit conversion.
+        eu = new ArincEU();
+        if (!eu->load(optarg))
+          exit(1);
+        break;
+      case 'f':		// channel:label[,label...][:sdi[,sdi...]] to keep; repeat to add more.
+        if (!filter)
+          filter = new ArincFilter();
+        if (!filter->parse(optarg)) {
+          fprintf(stderr, "Bad filter '%s', expected channel:label[,label...][:sdi[,sdi...]]\n", optarg);
+          exit(1);
+        }
+        break;
+      case 'm':		// Serve live metrics on http://127.0.0.1:port/metrics.
+        metricsPort = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-b] [-q] [-c] [-i report_secs] [-s] [-e label_file] [-f filter]... [-m metrics_port] [-w capture_file [-a prealloc_MB] [-D]]\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  rdr = new RdUDP(batchMode);
+  rdr->reader().setListing(listing);
+  rdr->reader().setReportInterval(reportInterval);
+  rdr->reader().setEU(eu);
+  rdr->reader().setFilter(filter);
+  rdr->reader().setCVT(cvt);
+
+  // /apmp.port for other processes; its CVT replaces a private one.
+  if (publish)
+  {
+    shm = new APMPshm(RdUDP::Port());
+    if (!shm->isOpen())
+      exit(1);
+    rdr->reader().setShm(shm);
+    rdr->reader().setCVT(shm->cvt());
+    if (cvt) {			// -c still prints it at exit.
+      delete cvt;
+      cvt = shm->cvt();
+    }
+  }
+
+  if (captureFile)
+  {
+    recorder = new APMPrecorder(captureFile, RdUDP::Port(), preallocate * 1024 * 1024, direct);
+    if (!recorder->isOpen())
+      exit(1);
+    rdr->reader().setRecorder(recorder);
+  }
+
+  if (metricsPort > 0)
+  {
+    metrics = new APMPmetrics();
+    rdr->reader().addMetrics(*metrics);
+    if (!metrics->serve(metricsPort))
+      exit(1);
+  }
 
   signal(SIGINT, sighandler);
   signal(SIGFPE, sighandler);
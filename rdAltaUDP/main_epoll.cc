@@ -0,0 +1,385 @@
+/*
+ * Headless APMP reader.  Same output as rdudp, but runs on a plain epoll
+ * loop; no QApplication, no signal/slot dispatch per packet.
+ *
+ * Each Alta unit has its own IP and port (see doc/nidas.xml), so -p may be
+ * given more than once.  Every port gets its own socket, reader state and
+ * worker thread, optionally pinned to a core, so one busy unit can not
+ * starve another.
+ *
+ * By default each unit also gets a second thread.  The network thread only
+ * reads datagrams into a lock free ring (apmp_ring.h); the decode thread
+ * swaps, checks, records and prints.  A slow stdout then backs up into the
+ * ring, and shows up as ring overruns, instead of stalling the socket into
+ * kernel drops.  -n 0 goes back to decoding on the network thread.
+ */
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "apmp_reader.h"
+#include "apmp_ring.h"
+
+static const int defaultPort = 56769;
+static const int defaultRingSlots = 4096;
+
+struct Device
+{
+  int		port;
+  int		cpu;		// -1 is no pinning.
+  int		decodeCpu;	// -1 is no pinning.
+  int		fd;
+  APMPreader	*reader;
+  APMPrecorder	*recorder;
+  ArincCVT	*cvt;
+  APMPshm	*shm;
+  APMPring	*ring;		// Null is decode on the network thread.
+  std::thread	thread;
+  std::thread	decodeThread;
+};
+
+
+/* -------------------------------------------------------------------- */
+static void pin(int port, int cpu)
+{
+  if (cpu < 0)
+    return;
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (rc != 0)
+    fprintf(stderr, "port %d: pin to cpu %d failed, %s\n", port, cpu, strerror(rc));
+}
+
+
+/* -------------------------------------------------------------------- */
+static void serve(Device *dev, int stopfd)
+{
+  struct epoll_event ev, events[2];
+  int efd;
+
+  pin(dev->port, dev->cpu);
+
+  if ((efd = epoll_create1(0)) < 0) {
+    perror("epoll_create1");
+    return;
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.fd = dev->fd;
+  epoll_ctl(efd, EPOLL_CTL_ADD, dev->fd, &ev);
+  ev.data.fd = stopfd;
+  epoll_ctl(efd, EPOLL_CTL_ADD, stopfd, &ev);
+
+  for (;;)
+  {
+    int n = epoll_wait(efd, events, 2, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      break;
+    }
+
+    bool stop = false;
+    for (int i = 0; i < n; ++i)
+    {
+      if (events[i].data.fd == stopfd)
+        stop = true;
+      else
+      if (events[i].events & EPOLLIN)
+      {
+        if (dev->ring)
+          dev->ring->receive(dev->fd);
+        else
+          dev->reader->readBatch(dev->fd);
+      }
+    }
+    if (stop)
+      break;
+  }
+
+  close(efd);
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Decode thread, consumer side of dev->ring.
+ */
+static void decode(Device *dev, int stopfd)
+{
+  struct pollfd stop;
+  stop.fd = stopfd;
+  stop.events = POLLIN;
+
+  pin(dev->port, dev->decodeCpu);
+
+  for (;;)
+  {
+    if (dev->ring->consume(dev->reader) > 0)
+      continue;
+
+    // Ring is empty.  Quit once asked to, after the network thread has
+    // stopped filling it.
+    if (poll(&stop, 1, 0) > 0)
+    {
+      dev->thread.join();
+      dev->ring->consume(dev->reader);
+      break;
+    }
+    dev->ring->wait(stopfd);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Parse "port[:cpu[:decode_cpu]]".
+ */
+static bool parseDevice(const char *spec, Device *dev)
+{
+  char *end;
+
+  dev->port = strtol(spec, &end, 10);
+  dev->cpu = -1;
+  dev->decodeCpu = -1;
+  if (*end == ':')
+    dev->cpu = strtol(end + 1, &end, 10);
+  if (*end == ':')
+    dev->decodeCpu = strtol(end + 1, &end, 10);
+
+  if (*end != '\0' || dev->port <= 0 || dev->port > 65535) {
+    fprintf(stderr, "Bad device spec '%s', expected port[:cpu[:decode_cpu]]\n", spec);
+    return false;
+  }
+  return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+  std::vector<Device *> devices;
+  bool direct = false, listing = true, useCVT = false, publish = false;
+  long long preallocate = 2048;		// MB
+  const char *captureFile = 0, *labelFile = 0;
+  ArincFilter *filter = 0;
+  int ringSlots = defaultRingSlots;
+  int reportInterval = 10;		// seconds
+  int metricsPort = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:w:a:Dqcn:i:se:f:m:")) != -1)
+  {
+    Device *dev;
+    switch (opt)
+    {
+      case 'p':		// port[:cpu[:decode_cpu]] of an Alta unit; repeat for more units.
+        dev = new Device();
+        if (!parseDevice(optarg, dev))
+          exit(1);
+        devices.push_back(dev);
+        break;
+      case 'w':		// Record raw datagrams to this capture file.
+        captureFile = optarg;
+        break;
+      case 'a':		// MB of file space to preallocate for the capture.
+        preallocate = atoll(optarg);
+        break;
+      case 'D':		// Write the capture with O_DIRECT.
+        direct = true;
+        break;
+      case 'q':		// No listing on stdout, statistics only.
+        listing = false;
+        break;
+      case 'c':		// Keep a current value table, printed at exit.
+        useCVT = true;
+        break;
+      case 'n':		// Receive ring slots per unit, 0 is no decode thread.
+        ringSlots = atoi(optarg);
+        break;
+      case 'i':		// Seconds between loss reports, 0 reports every anomaly.
+        reportInterval = atoi(optarg);
+        break;
+      case 's':		// Publish decoded words and the CVT in shared memory.
+        publish = true;
+        break;
+      case 'e':		// Label definitions for engineering unit conversion.
+        labelFile = optarg;
+        break;
+      case 'f':		// channel:label[,label...][:sdi[,sdi...]] to keep; repeat to add more.
+        if (!filter)
+          filter = new ArincFilter();
+        if (!filter->parse(optarg)) {
+          fprintf(stderr, "Bad filter '%s', expected channel:label[,label...][:sdi[,sdi...]]\n", optarg);
+          exit(1);
+        }
+        break;
+      case 'm':		// Serve live metrics on http://127.0.0.1:port/metrics.
+        metricsPort = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port[:cpu[:decode_cpu]]]... [-n ring_slots] [-i report_secs] [-q] [-c] [-s] [-e label_file] [-f filter]... [-m metrics_port] [-w capture_file [-a prealloc_MB] [-D]]\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  if (devices.empty())
+  {
+    Device *dev = new Device();
+    dev->port = defaultPort;
+    dev->cpu = -1;
+    dev->decodeCpu = -1;
+    devices.push_back(dev);
+  }
+
+  bool multi = devices.size() > 1;
+
+  // One table, read only once loaded, shared by every unit.
+  ArincEU *eu = 0;
+  if (labelFile) {
+    eu = new ArincEU();
+    if (!eu->load(labelFile))
+      exit(1);
+  }
+
+  for (size_t i = 0; i < devices.size(); ++i)
+  {
+    Device *dev = devices[i];
+
+    dev->reader = new APMPreader();
+    dev->reader->setListing(listing);
+    dev->reader->setReportInterval(reportInterval);
+    dev->reader->setEU(eu);
+    dev->reader->setFilter(filter);
+    if (multi)
+      dev->reader->setName(std::to_string(dev->port));
+
+    // /apmp.port for other processes; its CVT is the one kept.
+    if (publish)
+    {
+      dev->shm = new APMPshm(dev->port);
+      if (!dev->shm->isOpen())
+        exit(1);
+      dev->reader->setShm(dev->shm);
+      dev->reader->setCVT(dev->shm->cvt());
+    }
+    else
+    if (useCVT) {
+      dev->cvt = new ArincCVT();
+      dev->reader->setCVT(dev->cvt);
+    }
+
+    // One capture file per unit; file.port when there is more than one.
+    if (captureFile)
+    {
+      std::string name(captureFile);
+      if (multi)
+        name += "." + std::to_string(dev->port);
+      dev->recorder = new APMPrecorder(name, dev->port, preallocate * 1024 * 1024, direct);
+      if (!dev->recorder->isOpen())
+        exit(1);
+      dev->reader->setRecorder(dev->recorder);
+    }
+
+    if (ringSlots > 0)
+      dev->ring = new APMPring(ringSlots);
+
+    dev->fd = APMPreader::openSocket(dev->port);
+    printf("conn = %d\n", dev->fd >= 0);
+    if (dev->fd < 0)
+      exit(1);
+  }
+
+  // Every unit's counters on one endpoint, unit="port" when more than one.
+  APMPmetrics metrics;
+  if (metricsPort > 0)
+  {
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+      Device *dev = devices[i];
+      dev->reader->addMetrics(metrics);
+      if (dev->ring) {
+        std::string unit = multi ? "unit=\"" + std::to_string(dev->port) + "\"" : "";
+        metrics.counter("apmp_ring_overruns_total", "Datagrams dropped, receive ring full", unit.c_str(),
+		&dev->ring->overrunCounter());
+      }
+    }
+  }
+
+  // Block the signals in every thread; main picks them up with sigwait()
+  // and wakes the workers through the eventfd.
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, 0);
+
+  int stopfd = eventfd(0, EFD_NONBLOCK);
+  if (stopfd < 0) {
+    perror("eventfd");
+    exit(1);
+  }
+
+  if (metricsPort > 0 && !metrics.serve(metricsPort))
+    exit(1);
+
+  for (size_t i = 0; i < devices.size(); ++i)
+  {
+    devices[i]->thread = std::thread(serve, devices[i], stopfd);
+    if (devices[i]->ring)
+      devices[i]->decodeThread = std::thread(decode, devices[i], stopfd);
+  }
+
+  int sig;
+  sigwait(&sigs, &sig);
+
+  uint64_t one = 1;
+  if (write(stopfd, &one, sizeof(one)) < 0)
+    perror("eventfd write");
+  metrics.stop();
+
+  for (size_t i = 0; i < devices.size(); ++i)
+  {
+    Device *dev = devices[i];
+
+    // The decode thread joins the network thread before its final drain.
+    if (dev->ring)
+      dev->decodeThread.join();
+    else
+      dev->thread.join();
+    dev->reader->printStatistics();
+    if (dev->ring) {
+      dev->ring->printStatistics();
+      delete dev->ring;
+    }
+    if (useCVT)
+      (dev->shm ? dev->shm->cvt() : dev->cvt)->print(stdout);
+    delete dev->cvt;
+    delete dev->shm;
+    if (dev->recorder) {
+      dev->recorder->close();
+      dev->recorder->printStatistics();
+      delete dev->recorder;
+    }
+    close(dev->fd);
+    delete dev->reader;
+    delete dev;
+  }
+
+  close(stopfd);
+  delete eu;
+  delete filter;
+  return 0;
+}
@@ -0,0 +1,15 @@
+######################################################################
+# Offline APMP capture decoder.  qmake rdapmp_replay.pro; make -f Makefile.replay
+######################################################################
+
+TEMPLATE = app
+CONFIG += console c++17 thread release
+CONFIG -= qt
+TARGET = rdapmp_replay
+MAKEFILE = Makefile.replay
+INCLUDEPATH += .
+
+# Input
+HEADERS += apmp_reader.h apmp_swap.h arinc_decode.h arinc_eu.h arinc_filter.h apmp_capture.h apmp_recorder.h apmp_cvt.h apmp_stats.h apmp_latency.h apmp_time.h apmp_seqtrack.h apmp_shm.h apmp_format.h apmp_metrics.h
+SOURCES += replay.cc apmp_reader.cc apmp_swap.cc arinc_decode.cc arinc_eu.cc arinc_filter.cc apmp_recorder.cc apmp_cvt.cc apmp_latency.cc apmp_time.cc apmp_seqtrack.cc apmp_shm.cc apmp_format.cc apmp_metrics.cc
+LIBS += -lrt
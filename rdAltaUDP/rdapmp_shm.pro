@@ -0,0 +1,15 @@
+######################################################################
+# Shared memory consumer of rdudp -s output.  qmake rdapmp_shm.pro; make -f Makefile.shm
+######################################################################
+
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= qt
+TARGET = rdapmp_shm
+MAKEFILE = Makefile.shm
+INCLUDEPATH += .
+LIBS += -lrt
+
+# Input
+HEADERS += apmp_shm.h apmp_cvt.h arinc_decode.h AltaEnet.h
+SOURCES += shm_tail.cc apmp_shm.cc apmp_cvt.cc
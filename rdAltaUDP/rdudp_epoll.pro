@@ -0,0 +1,15 @@
+######################################################################
+# Headless APMP reader, no Qt.  qmake rdudp_epoll.pro; make -f Makefile.epoll
+######################################################################
+
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= qt
+TARGET = rdudp_epoll
+MAKEFILE = Makefile.epoll
+INCLUDEPATH += .
+
+# Input
+HEADERS += apmp_reader.h apmp_swap.h arinc_decode.h arinc_eu.h arinc_filter.h apmp_capture.h apmp_recorder.h apmp_cvt.h apmp_stats.h apmp_latency.h apmp_time.h apmp_seqtrack.h apmp_shm.h apmp_format.h apmp_metrics.h apmp_ring.h
+SOURCES += main_epoll.cc apmp_reader.cc apmp_swap.cc arinc_decode.cc arinc_eu.cc arinc_filter.cc apmp_recorder.cc apmp_cvt.cc apmp_latency.cc apmp_time.cc apmp_seqtrack.cc apmp_shm.cc apmp_format.cc apmp_metrics.cc apmp_ring.cc
+LIBS += -lrt
@@ -0,0 +1,230 @@
+/*
+ * Offline decode of APMP capture files written by rdudp -w.  The file is
+ * memory mapped and split by byte offset into one chunk per thread.  Each
+ * thread scans forward from its chunk start to the first record that
+ * checks out, then runs the records that start inside its chunk through
+ * its own APMPreader; the same header, sequence and label decoding the
+ * live reader does.  A corrupt record is skipped by scanning for the next
+ * good one.  Results are merged in file order so sequence checks across
+ * chunk boundaries are not lost.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <thread>
+#include <vector>
+
+#include "apmp_capture.h"
+#include "apmp_reader.h"
+
+
+struct Chunk
+{
+  const char	*begin, *end;	// Decode the records that start in [begin, end).
+  const char	*eof;
+  APMPreader	*reader;
+  size_t	records;
+  size_t	recordBytes;	// Record headers, datagrams and padding decoded.
+  size_t	resyncs;
+};
+
+/* -------------------------------------------------------------------- */
+// Sync word, a length the live reader could have received, and the whole
+// record inside the file.
+static bool recordAt(const char *p, const char *eof)
+{
+  const APMP_capture_rec *rec = (const APMP_capture_rec *)p;
+
+  return p + sizeof(APMP_capture_rec) <= eof && rec->sync == APMP_CAPTURE_SYNC &&
+	rec->length > 0 && rec->length < SLOT_SIZE &&
+	p + APMP_CAPTURE_STRIDE(rec->length) <= eof;
+}
+
+/* -------------------------------------------------------------------- */
+// First record at or after p, and before limit, whose stride lands on the
+// end of file, another record or the zero fill of a capture cut short.
+// Records are 8 byte aligned in the file, so only those offsets are tried.
+static const char *resync(const char *p, const char *limit, const char *eof)
+{
+  static const char zeros[sizeof(APMP_capture_rec)] = { 0 };
+
+  for (; p < limit; p += 8)
+  {
+    if (!recordAt(p, eof))
+      continue;
+
+    const char *next = p + APMP_CAPTURE_STRIDE(((const APMP_capture_rec *)p)->length);
+    if (next == eof || recordAt(next, eof) ||
+	(next + sizeof(zeros) <= eof && memcmp(next, zeros, sizeof(zeros)) == 0))
+      return p;
+  }
+  return limit;
+}
+
+/* -------------------------------------------------------------------- */
+static void decodeChunk(Chunk *chunk, bool first)
+{
+  char buffer[SLOT_SIZE];
+
+  // The first chunk starts right after the file header, on a record.
+  const char *p = first ? chunk->begin : resync(chunk->begin, chunk->end, chunk->eof);
+
+  while (p < chunk->end)
+  {
+    if (!recordAt(p, chunk->eof)) {
+      p = resync(p + 8, chunk->end, chunk->eof);
+      ++chunk->resyncs;
+      continue;
+    }
+
+    const APMP_capture_rec *rec = (const APMP_capture_rec *)p;
+    struct timespec ts;
+
+    ts.tv_sec = rec->hostTime / 1000000000ULL;
+    ts.tv_nsec = rec->hostTime % 1000000000ULL;
+
+    // processPacket() swaps in place, and the mapping is read only.
+    memcpy(buffer, (const char *)(rec + 1), rec->length);
+    buffer[rec->length] = '\0';
+    chunk->reader->processPacket(buffer, rec->length, ts);
+
+    ++chunk->records;
+    chunk->recordBytes += APMP_CAPTURE_STRIDE(rec->length);
+    p += APMP_CAPTURE_STRIDE(rec->length);
+  }
+  chunk->reader->flush();
+}
+
+/* -------------------------------------------------------------------- */
+static int replay(const char *fileName, int nThreads, bool listing)
+{
+  int fd;
+  struct stat st;
+
+  if ((fd = open(fileName, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "replay: %s: %s\n", fileName, strerror(errno));
+    return 1;
+  }
+
+  if (st.st_size < (off_t)sizeof(APMP_capture_hdr)) {
+    fprintf(stderr, "replay: %s: too short for a capture file.\n", fileName);
+    close(fd);
+    return 1;
+  }
+
+  const char *map = (const char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "replay: mmap(%s): %s\n", fileName, strerror(errno));
+    return 1;
+  }
+  // Not MADV_SEQUENTIAL; the decode threads each read their own region.
+  madvise((void *)map, st.st_size, MADV_WILLNEED);
+
+  const APMP_capture_hdr *hdr = (const APMP_capture_hdr *)map;
+  if (hdr->magic != APMP_CAPTURE_MAGIC || hdr->version != APMP_CAPTURE_VERSION) {
+    fprintf(stderr, "replay: %s: not an APMP capture file (magic=0x%08x version=%u).\n",
+	fileName, hdr->magic, hdr->version);
+    munmap((void *)map, st.st_size);
+    return 1;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Listing has to come out in order; one thread.  Otherwise no chunk
+  // smaller than a megabyte, where the thread start would cost more than
+  // the decode.
+  const char *data = map + sizeof(APMP_capture_hdr), *eof = map + st.st_size;
+  if (listing || nThreads < 1)
+    nThreads = 1;
+  if (nThreads > (eof - data) / (1 << 20))
+    nThreads = (eof - data) / (1 << 20) > 0 ? (eof - data) / (1 << 20) : 1;
+
+  std::vector<Chunk> chunks(nThreads);
+  std::vector<std::thread> threads;
+  size_t perThread = ((eof - data) / nThreads + 7) & ~(size_t)7;
+
+  for (int i = 0; i < nThreads; ++i)
+  {
+    Chunk &c = chunks[i];
+
+    c.begin = std::min(eof, data + i * perThread);
+    c.end = i == nThreads - 1 ? eof : std::min(eof, c.begin + perThread);
+    c.eof = eof;
+    c.reader = new APMPreader();
+    c.reader->setListing(listing);
+    c.records = c.recordBytes = c.resyncs = 0;
+    threads.push_back(std::thread(decodeChunk, &c, i == 0));
+  }
+
+  size_t records = 0, recordBytes = 0, resyncs = 0;
+  for (int i = 0; i < nThreads; ++i)
+  {
+    threads[i].join();
+    records += chunks[i].records;
+    recordBytes += chunks[i].recordBytes;
+    resyncs += chunks[i].resyncs;
+    if (i > 0) {
+      chunks[0].reader->merge(*chunks[i].reader);
+      delete chunks[i].reader;
+    }
+  }
+
+  if (data + recordBytes != eof)
+    fprintf(stderr, "replay: %s: %ld bytes outside good records skipped, %zu resync(s).\n",
+	fileName, (long)(eof - data - recordBytes), resyncs);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+
+  printf("\n\n%s: %zu datagrams, %lld bytes, port %u\n", fileName, records, (long long)st.st_size, hdr->port);
+  chunks[0].reader->printStatistics();
+  printf("\n\nDecoded in %.3f s with %d thread(s), %.1f MB/s, %.0f datagrams/s\n",
+	elapsed, nThreads, st.st_size / elapsed / 1.0e6, records / elapsed);
+
+  delete chunks[0].reader;
+  munmap((void *)map, st.st_size);
+  return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  int nThreads = std::thread::hardware_concurrency();
+  bool listing = false;
+  int opt, rc = 0;
+
+  while ((opt = getopt(argc, argv, "j:p")) != -1)
+  {
+    switch (opt)
+    {
+      case 'j':		// Number of decode threads.
+        nThreads = atoi(optarg);
+        break;
+      case 'p':		// Print the same listing rdudp does; single threaded.
+        listing = true;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-j threads] [-p] capture_file ...\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-j threads] [-p] capture_file ...\n", argv[0]);
+    exit(1);
+  }
+
+  for (int i = optind; i < argc; ++i)
+    rc |= replay(argv[i], nThreads, listing);
+
+  return rc;
+}
@@ -0,0 +1,101 @@
+/*
+ * Follow the decoded ARINC words an rdudp or rdudp_epoll run with -s
+ * publishes in /apmp.<port>; an example shared memory consumer and a
+ * quick look tool.  No socket and no decoding here.
+ *
+ *   rdapmp_shm [-p port]		print words as they arrive
+ *   rdapmp_shm [-p port] -c		print the current value table and exit
+ */
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+#include "apmp_shm.h"
+
+static const int defaultPort = 56769;
+
+static volatile sig_atomic_t stop = 0;
+
+static void sighandler(int)
+{
+  stop = 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+  int port = defaultPort;
+  bool dumpCVT = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:c")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p':		// Port of the unit whose segment to attach.
+        port = atoi(optarg);
+        break;
+      case 'c':		// Print the current value table and exit.
+        dumpCVT = true;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-p port] [-c]\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  APMPshmReader shm;
+  if (!shm.attach(port))
+    exit(1);
+
+  if (dumpCVT) {
+    shm.cvt().print(stdout);
+    return 0;
+  }
+
+  signal(SIGINT, sighandler);
+  signal(SIGTERM, sighandler);
+
+  long long nWords = 0, nBad = 0;
+  struct timespec idle = { 0, 1000000 };	// 1ms
+
+  while (!stop)
+  {
+    const APMPshmWord *w;
+    int n = shm.peek(w);
+
+    if (n == 0)
+    {
+      if (shm.header().closed.load(std::memory_order_acquire))
+        break;
+      nanosleep(&idle, 0);
+      continue;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+      time_t sec = w[i].utc / 1000000000LL;
+      long tod = sec % 86400;
+      printf("  %02ld:%02ld:%02ld.%09lld  %d  %04o  %d  0x%08x  error=%d",
+		tod / 3600, tod / 60 % 60, tod % 60, w[i].utc % 1000000000LL,
+		w[i].channel, w[i].label, w[i].sdi, w[i].word, w[i].error);
+      if (w[i].def)
+        printf("  %.9g", w[i].value);
+      printf("\n");
+    }
+
+    // Anything overwritten while we printed it was garbage; say so.
+    int bad = shm.release(n);
+    if (bad > 0) {
+      printf("  ** %d words above overwritten while being read\n", bad);
+      nBad += bad;
+    }
+    nWords += n - bad;
+  }
+
+  fprintf(stderr, "%lld words, %llu missed (fell a ring behind), %lld overwritten while read\n",
+	nWords, (unsigned long long)shm.missed(), nBad);
+  return 0;
+}
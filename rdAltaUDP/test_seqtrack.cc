@@ -0,0 +1,123 @@
+/*
+ * Checks of APMPseqTracker on hand made sequences, and of APMPreader's
+ * per-channel tracking over APMPsynth datagrams with whole datagrams
+ * dropped.  Prints each failure; exit status is the number of them.
+ */
+#include <cstdio>
+#include <ctime>
+
+#include "apmp_reader.h"
+#include "apmp_synth.h"
+
+static int failures = 0;
+
+static void expect(const char *name, const APMPseqCounts &c, uint64_t received,
+	uint64_t lost, uint64_t duplicate, uint64_t reordered, uint64_t resync)
+{
+  if (c.received == received && c.lost == lost && c.duplicate == duplicate &&
+      c.reordered == reordered && c.resync == resync)
+    return;
+  printf("FAIL %s: received %llu lost %llu dup %llu reordered %llu resync %llu,"
+	" expected %llu %llu %llu %llu %llu\n", name,
+	(unsigned long long)c.received, (unsigned long long)c.lost, (unsigned long long)c.duplicate,
+	(unsigned long long)c.reordered, (unsigned long long)c.resync,
+	(unsigned long long)received, (unsigned long long)lost, (unsigned long long)duplicate,
+	(unsigned long long)reordered, (unsigned long long)resync);
+  ++failures;
+}
+
+static APMPseqCounts run(APMPseqTracker &t, const uint32_t *seq, int n)
+{
+  APMPseqCounts c;
+  for (int i = 0; i < n; ++i)
+    t.add(seq[i]);
+  t.snapshot(c);
+  return c;
+}
+
+/* -------------------------------------------------------------------- */
+static void trackerChecks()
+{
+  {
+    APMPseqTracker t(32);
+    const uint32_t seq[] = { 0, 1, 2, 5, 3, 6, 6 };
+    expect("gap, late fill, duplicate", run(t, seq, 7), 7, 1, 1, 1, 0);
+  }
+  {
+    // Nothing below the first was ever counted lost.
+    APMPseqTracker t(32);
+    const uint32_t seq[] = { 10, 9, 11 };
+    expect("out of order first arrival", run(t, seq, 3), 3, 0, 0, 1, 0);
+  }
+  {
+    APMPseqTracker t(32);
+    const uint32_t seq[] = { 1000, 1001, 10, 9, 11 };
+    expect("late arrival after resync", run(t, seq, 5), 5, 0, 0, 1, 1);
+  }
+  {
+    APMPseqTracker t(8);
+    const uint32_t seq[] = { 250, 251, 255, 0, 2, 253, 1 };
+    expect("8 bit rollover", run(t, seq, 7), 7, 2, 0, 2, 0);
+  }
+  {
+    APMPseqTracker t(8);
+    APMPseqCounts c;
+    for (uint32_t s = 0; s < 100; ++s)
+      t.add(s);
+    t.resync();
+    for (uint32_t s = 1100; s < 1200; ++s)
+      t.add(s);
+    t.snapshot(c);
+    expect("8 bit jump past half, resync()", c, 200, 0, 0, 0, 1);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Full datagrams, every channel, with bursts of drops and single drops.
+ * No RXP is ever sent twice, so no channel may show a duplicate.
+ */
+static void readerChecks()
+{
+  APMPsynth synth(7);
+  APMPreader reader;
+  static char slot[APMP_MAX_PACKET];
+  struct timespec utc = { 1700000000, 0 };
+  long long peTicks = 50000000;
+  int dropped = 0;
+
+  reader.setListing(false);
+  reader.setReportInterval(3600);	// quiet; no report in 20 s of data
+  for (int i = 0; i < 20000; ++i, peTicks += 50000)
+  {
+    long long ns = peTicks * 20 + 100000;
+    utc.tv_sec = 1700000000 + ns / 1000000000LL;
+    utc.tv_nsec = ns % 1000000000LL;
+    int n = synth.build(slot, peTicks, utc);
+    if ((i % 500 >= 100 && i % 500 < 101 + i / 500 % 30) || i % 331 == 0)
+      ++dropped;
+    else
+      reader.processPacket(slot, n, utc);
+  }
+  reader.flush();
+
+  APMPseqCounts c;
+  for (int channel = 0; channel < 8; ++channel)
+  {
+    reader.seqSnapshot(channel, c);
+    if (c.duplicate != 0 || c.reordered != 0) {
+      printf("FAIL channel %d after %d datagrams dropped: dup %llu reordered %llu\n", channel,
+	dropped, (unsigned long long)c.duplicate, (unsigned long long)c.reordered);
+      ++failures;
+    }
+  }
+}
+
+/* -------------------------------------------------------------------- */
+int main()
+{
+  trackerChecks();
+  readerChecks();
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures;
+}
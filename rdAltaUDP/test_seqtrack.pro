@@ -0,0 +1,15 @@
+######################################################################
+# Sequence tracker checks.  qmake test_seqtrack.pro; make -f Makefile.test_seqtrack; ./test_seqtrack
+######################################################################
+
+TEMPLATE = app
+CONFIG += console c++17 thread release
+CONFIG -= qt
+TARGET = test_seqtrack
+MAKEFILE = Makefile.test_seqtrack
+INCLUDEPATH += .
+
+# Input
+HEADERS += apmp_reader.h apmp_swap.h arinc_decode.h arinc_eu.h arinc_filter.h apmp_capture.h apmp_recorder.h apmp_cvt.h apmp_stats.h apmp_latency.h apmp_time.h apmp_seqtrack.h apmp_shm.h apmp_format.h apmp_metrics.h apmp_synth.h
+SOURCES += test_seqtrack.cc apmp_reader.cc apmp_swap.cc arinc_decode.cc arinc_eu.cc arinc_filter.cc apmp_recorder.cc apmp_cvt.cc apmp_latency.cc apmp_time.cc apmp_seqtrack.cc apmp_shm.cc apmp_format.cc apmp_metrics.cc apmp_synth.cc
+LIBS += -lrt